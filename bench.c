@@ -0,0 +1,843 @@
+// Database benchmarks for tday
+//
+// Generates a database of the requested size and shape, then times the code paths tday runs on it.
+// Every result is printed as one JSON object per line, latencies in microseconds:
+//
+//   {"op":"load_entries_first","rows":100000,"samples":1000,"p50_us":12.1,"p99_us":30.5,...}
+
+#include <sys/wait.h>
+
+#define TDAY_NO_MAIN
+#include "tday.c"
+
+#define BENCH_DB_PATH "bench.db"
+#define BENCH_SOCKET_PATH "bench.sock"
+#define BENCH_SYNC_BATCH 100
+#define BENCH_SYNC_BATCHES 50
+#define BENCH_BATCH_ROWS 50000
+#define BENCH_REPLAY_SCROLL_ROWS 10000
+#define BENCH_REPLAY_NEW_TASKS 1000
+#define BENCH_REPLAY_TOGGLE_ROWS 2000
+#define BENCH_TAGS 16
+#define BENCH_RARE_TAGGED 3 // tasks of today given a tag no other task has, see bench_filter
+#define BENCH_TAGGED_RATIO 0.4
+#define BENCH_PRIORITY_RATIO 0.1
+
+#define create_gen_batch_sql                   \
+    "CREATE TEMP TABLE IF NOT EXISTS gen_batch(" \
+    "id INTEGER PRIMARY KEY, "                   \
+    "description TEXT NOT NULL, "                \
+    "completed INTEGER, "                        \
+    "ignored INTEGER, "                          \
+    "updated_at INTEGER, "                       \
+    "day INTEGER"                                \
+    ");"
+
+#define stage_gen_entry_sql "INSERT INTO temp.gen_batch VALUES (?, ?, ?, ?, ?, ?);"
+
+#define flush_gen_batch_sql                                                                              \
+    "INSERT INTO entries (id, description, completed, ignored, updated_at, day, position, created_day) " \
+    "SELECT id, description, completed, ignored, updated_at, day, id * 1024, day FROM temp.gen_batch;"   \
+    "DELETE FROM temp.gen_batch;"
+
+typedef enum UpdatedDistribution { UPDATED_UNIFORM, UPDATED_RECENT } updated_distribution_t;
+
+typedef struct BenchConfig {
+    long rows;
+    double completed_ratio;
+    double ignored_ratio;
+    double updated_ratio;
+    int updated_span_days;
+    updated_distribution_t updated_distribution;
+    int samples;
+    const char *path;
+    int keep; // reuse an existing database instead of generating one
+    int check_plan; // only check the list query plans, see check_list_query_plan()
+} bench_config_t;
+
+static const char *words[] = {
+    "work", "on", "tday", "study", "opengl", "read", "japanese", "write", "report", "call", "mom", "fix", "bug",
+    "review", "pull", "request", "buy", "milk", "plan", "trip", "clean", "desk", "email", "team", "book", "flight",
+    "pay", "rent", "water", "plants", "update", "docs", "refactor", "parser", "benchmark", "sqlite", "index",
+};
+
+#define WORDS_COUNT (sizeof(words) / sizeof(words[0]))
+
+double rand_unit(void) { return rand() / (RAND_MAX + 1.0); }
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+void report(const bench_config_t *config, const char *op, double *samples, int n) {
+    if (n == 0) {
+        return;
+    }
+    qsort(samples, n, sizeof(double), cmp_double);
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+    int p99 = (int)ceil(n * 0.99) - 1;
+    printf("{\"op\":\"%s\",\"rows\":%ld,\"samples\":%d,\"p50_us\":%.1f,\"p99_us\":%.1f,\"mean_us\":%.1f,"
+           "\"min_us\":%.1f,\"max_us\":%.1f}\n",
+           op, config->rows, n, samples[n / 2], samples[p99 < 0 ? 0 : p99], sum / n, samples[0], samples[n - 1]);
+    fflush(stdout);
+}
+
+sqlite3_int64 gen_updated_at(const bench_config_t *config, sqlite3_int64 now) {
+    double r = rand_unit();
+    if (config->updated_distribution == UPDATED_RECENT) {
+        // Most tasks were touched recently, a long tail goes back to the start of the span
+        r = r * r * r;
+    }
+    return now - (sqlite3_int64)(r * config->updated_span_days * 86400.0) - 1;
+}
+
+int generate(const bench_config_t *config) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    sqlite3_int64 now = time(NULL);
+    int first_day = today() - config->updated_span_days;
+    char description[128];
+    double start = now_us();
+
+    check_db_err(sqlite3_exec(DB, create_gen_batch_sql, NULL, NULL, NULL), "create_gen_batch");
+    check_db_err(sqlite3_prepare_v2(DB, stage_gen_entry_sql, -1, &stmt, 0), "prepare_stage_gen_entry_stmt");
+    for (long id = 1; id <= config->rows; id++) {
+        if ((id - 1) % BENCH_BATCH_ROWS == 0) {
+            check_db_err(sqlite3_exec(DB, "BEGIN;", NULL, NULL, NULL), "begin_gen_batch");
+        }
+        int n = 0;
+        int count = 2 + rand() % 5;
+        for (int w = 0; w < count; w++) {
+            n += snprintf(description + n, sizeof(description) - n, "%s%s", w ? " " : "", words[rand() % WORDS_COUNT]);
+        }
+        // Some tasks are tagged or have a priority, see the Tags section of tday.c
+        if (rand_unit() < BENCH_TAGGED_RATIO) {
+            n += snprintf(description + n, sizeof(description) - n, " #tag%d", rand() % BENCH_TAGS);
+        }
+        if (rand_unit() < BENCH_PRIORITY_RATIO) {
+            snprintf(description + n, sizeof(description) - n, " %.*s", 1 + rand() % PRIORITY_MAX, "!!!");
+        }
+        sqlite3_bind_int64(stmt, 1, id);
+        sqlite3_bind_text(stmt, 2, description, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 3, rand_unit() < config->completed_ratio);
+        sqlite3_bind_int(stmt, 4, rand_unit() < config->ignored_ratio);
+        // Tasks belong to the day they were last touched on, untouched ones to any day of the span
+        if (rand_unit() < config->updated_ratio) {
+            sqlite3_int64 updated_at = gen_updated_at(config, now);
+            sqlite3_bind_int64(stmt, 5, updated_at);
+            sqlite3_bind_int(stmt, 6, day_of(updated_at));
+        } else {
+            sqlite3_bind_null(stmt, 5);
+            sqlite3_bind_int(stmt, 6, first_day + rand() % (config->updated_span_days + 1));
+        }
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            fprintf(stderr, "[error] step_stage_gen_entry_stmt: %s\n", sqlite3_errmsg(DB));
+            return_defer(1);
+        }
+        sqlite3_reset(stmt);
+        if (id % BENCH_BATCH_ROWS == 0 || id == config->rows) {
+            check_db_err(sqlite3_exec(DB, flush_gen_batch_sql "COMMIT;", NULL, NULL, NULL), "flush_gen_batch");
+        }
+    }
+    fprintf(stderr, "generated %ld rows in %.1fs\n", config->rows, (now_us() - start) / 1e6);
+    return_defer(0);
+defer:
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// Opens the database the way tday does: schema, migrations, writer connection settings. Statements are
+// prepared as they first run.
+int bench_open(const char *path) {
+    int result = 0;
+    if (open_db(path) != 0) {
+        return_defer(1);
+    }
+    check_db_err(sqlite3_exec(DB, "PRAGMA journal_mode = WAL; PRAGMA synchronous = NORMAL;", NULL, 0, NULL), "wal");
+    WRITER_DB = DB;
+    return_defer(0);
+defer:
+    return result;
+}
+
+void bench_close(void) {
+    finalize_read_stmts();
+    finalize_write_stmts();
+    sqlite3_close(DB);
+    DB = NULL;
+    WRITER_DB = NULL;
+}
+
+// Picks a random entry that is in the list
+int random_entry(entry_t *entry) {
+    static sqlite3_stmt *stmt = NULL;
+    static arena_t arena = {0};
+    if (stmt == NULL && sqlite3_prepare_v2(DB,
+                                           "SELECT id, description, completed, ifnull(updated_at, 0), day, position "
+                                                "FROM entries "
+                                                "WHERE ignored = 0 AND id >= ? * (SELECT max(id) FROM entries) "
+                                                "ORDER BY id LIMIT 1;",
+                                           -1, &stmt, 0) != SQLITE_OK) {
+        return 1;
+    }
+    if (entry == NULL) {
+        sqlite3_finalize(stmt);
+        stmt = NULL;
+        arena_free(&arena);
+        return 0;
+    }
+    arena_reset(&arena);
+    sqlite3_bind_double(stmt, 1, rand_unit());
+    int found = sqlite3_step(stmt) == SQLITE_ROW;
+    if (found) {
+        memset(entry, 0, sizeof(*entry));
+        entry->id = sqlite3_column_int(stmt, 0);
+        entry->description =
+            arena_strndup(&arena, (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1));
+        entry->completed = sqlite3_column_int(stmt, 2);
+        entry->updated_at = sqlite3_column_int64(stmt, 3);
+        entry->day = sqlite3_column_int(stmt, 4);
+        entry->position = sqlite3_column_double(stmt, 5);
+    }
+    sqlite3_reset(stmt);
+    return !found;
+}
+
+void bench_load_entries(const bench_config_t *config, double *samples) {
+    int want = list_view_height(DEFAULT_ROWS, 0) + LIST_PREFETCH_ROWS;
+    entry_t *entries = malloc(sizeof(entry_t) * want);
+    arena_t arena = {0};
+    int n = 0;
+
+    for (int i = 0; i < config->samples; i++) {
+        double start = now_us();
+        arena_reset(&arena);
+        load_entries(today(), NULL, NULL, 1, entries, want, &n, &arena);
+        samples[i] = now_us() - start;
+    }
+    report(config, "load_entries_first", samples, config->samples);
+
+    int taken = 0;
+    for (int i = 0; i < config->samples; i++) {
+        entry_t from;
+        if (random_entry(&from) != 0) {
+            continue;
+        }
+        int direction = i % 2 ? 1 : -1;
+        double start = now_us();
+        arena_reset(&arena);
+        load_entries(from.day, NULL, &from, direction, entries, LIST_PREFETCH_ROWS, &n, &arena);
+        samples[taken++] = now_us() - start;
+    }
+    report(config, "load_entries_page", samples, taken);
+    free(entries);
+    arena_free(&arena);
+}
+
+void bench_mutations(const bench_config_t *config, double *samples) {
+    int taken = 0;
+    for (int i = 0; i < config->samples; i++) {
+        entry_t entry;
+        if (random_entry(&entry) != 0) {
+            continue;
+        }
+        entry.completed = !entry.completed;
+        entry.updated_at = time(NULL);
+        double start = now_us();
+        update_entry(&entry);
+        samples[taken++] = now_us() - start;
+    }
+    report(config, "update_entry", samples, taken);
+
+    sqlite3_int64 first_new_id;
+    if (reserve_entry_ids(DB, config->samples, &first_new_id) != 0) {
+        return;
+    }
+    for (int i = 0; i < config->samples; i++) {
+        char description[32];
+        snprintf(description, sizeof(description), "benchmark task %d", i);
+        entry_t entry = {0};
+        entry.id = first_new_id + i;
+        entry.day = today();
+        entry.description = description;
+        double start = now_us();
+        new_entry(&entry);
+        samples[i] = now_us() - start;
+    }
+    report(config, "new_entry", samples, config->samples);
+
+    // Delete the entries that were just added, so the database keeps its shape between runs
+    for (int i = 0; i < config->samples; i++) {
+        entry_t entry = {0};
+        entry.id = first_new_id + i;
+        double start = now_us();
+        delete_entry(&entry);
+        samples[i] = now_us() - start;
+    }
+    report(config, "delete_entry", samples, config->samples);
+}
+
+// Clearing touches every completed entry, so each sample first completes a few entries to clear.
+// Undoing a clear only touches the entries it cleared; each one is undone and cleared again.
+void bench_clear_completed(const bench_config_t *config, double *samples) {
+    int n = config->samples < 50 ? config->samples : 50;
+    double *restore_samples = malloc(sizeof(double) * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < 10; j++) {
+            entry_t entry;
+            if (random_entry(&entry) == 0) {
+                entry.completed = 1;
+                entry.updated_at = time(NULL);
+                update_entry(&entry);
+            }
+        }
+        sqlite3_int64 cleared_at = next_clear_time();
+        double start = now_us();
+        clear_completed_entries(cleared_at);
+        samples[i] = now_us() - start;
+        start = now_us();
+        restore_cleared_entries(cleared_at);
+        restore_samples[i] = now_us() - start;
+        clear_completed_entries(cleared_at);
+    }
+    report(config, "clear_completed_entries", samples, n);
+    report(config, "restore_cleared_entries", restore_samples, n);
+    free(restore_samples);
+}
+
+// Rolling over only touches the unfinished tasks of earlier days, so each sample first moves a few open
+// tasks back to yesterday
+void bench_rollover(const bench_config_t *config, double *samples) {
+    int n = config->samples < 50 ? config->samples : 50;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < 10; j++) {
+            entry_t entry;
+            if (random_entry(&entry) == 0 && !entry.completed) {
+                char sql[128];
+                snprintf(sql, sizeof(sql), "UPDATE entries SET day = %d WHERE id = %d;", today() - 1, entry.id);
+                sqlite3_exec(DB, sql, NULL, NULL, NULL);
+            }
+        }
+        double start = now_us();
+        rollover_entries(today());
+        samples[i] = now_us() - start;
+    }
+    report(config, "rollover_entries", samples, n);
+}
+
+// A move reads the entry after the moved one and writes the moved row only. Rebalancing rewrites a
+// whole day, so each sample first shifts today's positions off the grid it restores.
+void bench_moves(const bench_config_t *config, double *samples) {
+    arena_t arena = {0};
+    int taken = 0;
+    for (int i = 0; i < config->samples; i++) {
+        entry_t entry, after;
+        int n = 0;
+        if (random_entry(&entry) != 0) {
+            continue;
+        }
+        double start = now_us();
+        arena_reset(&arena);
+        load_entries(entry.day, NULL, &entry, 1, &after, 1, &n, &arena);
+        entry.position = position_between(&entry, n > 0 ? &after : NULL);
+        update_entry(&entry);
+        samples[taken++] = now_us() - start;
+    }
+    report(config, "move_entry", samples, taken);
+    arena_free(&arena);
+
+    int n = config->samples < 20 ? config->samples : 20;
+    char sql[128];
+    snprintf(sql, sizeof(sql), "UPDATE entries SET position = position + 0.5 WHERE day = %d AND ignored = 0;",
+             today());
+    for (int i = 0; i < n; i++) {
+        sqlite3_exec(DB, sql, NULL, NULL, NULL);
+        double start = now_us();
+        rebalance_entries(today());
+        samples[i] = now_us() - start;
+    }
+    report(config, "rebalance_entries", samples, n);
+}
+
+// The activity view reads the counters of a few weeks, wherever they are in the history: today's and
+// those of random weeks over the span of the generated updates
+void bench_activity(const bench_config_t *config, double *samples) {
+    activity_t activity;
+    for (int i = 0; i < config->samples; i++) {
+        double start = now_us();
+        load_activity(today(), today(), &activity);
+        samples[i] = now_us() - start;
+    }
+    report(config, "load_activity_today", samples, config->samples);
+
+    for (int i = 0; i < config->samples; i++) {
+        int end = today() - (int)(rand_unit() * config->updated_span_days);
+        double start = now_us();
+        load_activity(end, today(), &activity);
+        samples[i] = now_us() - start;
+    }
+    report(config, "load_activity_past", samples, config->samples);
+}
+
+// The filter view lists the tags, then the list loads the first page of today with a random tag, with
+// a minimum priority, and with both
+void bench_filter(const bench_config_t *config, double *samples) {
+    int want = list_view_height(DEFAULT_ROWS, 0) + LIST_PREFETCH_ROWS;
+    entry_t *entries = malloc(sizeof(entry_t) * want);
+    tag_t tags[BENCH_TAGS + 1]; // and the rare one
+    arena_t arena = {0};
+    int n = 0, tags_sz = 0;
+
+    for (int i = 0; i < config->samples; i++) {
+        double start = now_us();
+        load_tags(tags, BENCH_TAGS, &tags_sz);
+        samples[i] = now_us() - start;
+    }
+    report(config, "load_tags", samples, config->samples);
+
+    static const char *ops[] = {"load_entries_filtered_tag", "load_entries_filtered_priority",
+                                "load_entries_filtered_both"};
+    for (int op = 0; op < 3 && tags_sz > 0; op++) {
+        for (int i = 0; i < config->samples; i++) {
+            filter_t filter = {.priority = op > 0 ? 2 : 0};
+            if (op != 1) {
+                filter.tags[filter.tags_sz++] = tags[rand() % tags_sz];
+            }
+            double start = now_us();
+            arena_reset(&arena);
+            load_entries(today(), &filter, NULL, 1, entries, want, &n, &arena);
+            samples[i] = now_us() - start;
+        }
+        report(config, ops[op], samples, config->samples);
+    }
+
+    // A tag only a few tasks of a large day have, which the list would otherwise walk the whole day for
+    char sql[256];
+    snprintf(sql, sizeof(sql),
+             "UPDATE entries SET description = description || ' #rare' WHERE id IN "
+             "(SELECT id FROM entries WHERE day = %d AND ignored = 0 ORDER BY random() LIMIT %d);",
+             today(), BENCH_RARE_TAGGED);
+    sqlite3_exec(DB, sql, NULL, NULL, NULL);
+    filter_t rare = {0};
+    load_tags(tags, BENCH_TAGS + 1, &tags_sz);
+    for (int i = 0; i < tags_sz; i++) {
+        if (strcmp(tags[i].name, "rare") == 0) {
+            rare.tags[rare.tags_sz++] = tags[i];
+        }
+    }
+    for (int i = 0; i < config->samples && rare.tags_sz > 0; i++) {
+        double start = now_us();
+        arena_reset(&arena);
+        load_entries(today(), &rare, NULL, 1, entries, want, &n, &arena);
+        samples[i] = now_us() - start;
+    }
+    report(config, "load_entries_filtered_rare_tag", samples, rare.tags_sz > 0 ? config->samples : 0);
+    sqlite3_exec(DB,
+                 "UPDATE entries SET description = replace(description, ' #rare', '') "
+                 "WHERE instr(description, ' #rare') > 0;",
+                 NULL, NULL, NULL);
+    free(entries);
+    arena_free(&arena);
+}
+
+// Syncing costs the changes exchanged, not the rows: batches of BENCH_SYNC_BATCH of the latest changes
+// are exported one at a time, then applied in order to a new, empty database
+void bench_sync(const bench_config_t *config, double *samples) {
+    int n = config->samples < BENCH_SYNC_BATCHES ? config->samples : BENCH_SYNC_BATCHES;
+    FILE *batches[BENCH_SYNC_BATCHES] = {0};
+    sqlite3_int64 since = 0;
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(DB, "SELECT ifnull(max(seq), 0) FROM changes;", -1, &stmt, 0) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        since = sqlite3_column_int64(stmt, 0) - (sqlite3_int64)n * BENCH_SYNC_BATCH;
+    }
+    sqlite3_finalize(stmt);
+    since = since < 0 ? 0 : since;
+    for (int i = 0; i < n; i++) {
+        long exported;
+        batches[i] = tmpfile();
+        if (batches[i] == NULL) {
+            n = i;
+            break;
+        }
+        double start = now_us();
+        export_changes(DB, since, BENCH_SYNC_BATCH, batches[i], &exported, &since);
+        samples[i] = now_us() - start;
+    }
+    report(config, "export_changes", samples, n);
+
+    char peer[1024];
+    snprintf(peer, sizeof(peer), "%s-peer", config->path);
+    random_entry(NULL);
+    bench_close();
+    unlink(peer);
+    int taken = 0;
+    if (open_db(peer) == 0) {
+        for (int i = 0; i < n; i++) {
+            long applied, skipped;
+            rewind(batches[i]);
+            double start = now_us();
+            if (apply_changes(DB, batches[i], &applied, &skipped) == 0) {
+                samples[taken++] = now_us() - start;
+            }
+        }
+    }
+    report(config, "apply_changes", samples, taken);
+    for (int i = 0; i < n; i++) {
+        fclose(batches[i]);
+    }
+    sqlite3_close(DB);
+    unlink(peer);
+    bench_open(config->path);
+}
+
+// Starting up the way tday does, on an already created database, with the frames written to /dev/null:
+// the time to the first frame, to taking keys once the writer is started, and each phase on its own
+void bench_startup(const bench_config_t *config, double *samples) {
+    int n = config->samples < 200 ? config->samples : 200;
+    double *phases = malloc(sizeof(double) * n * STARTUP_PHASES);
+    double *ready = malloc(sizeof(double) * n);
+    int out = open("/dev/null", O_WRONLY);
+    if (phases == NULL || ready == NULL || out < 0) {
+        fprintf(stderr, "[error] bench_startup: out of memory\n");
+        return;
+    }
+    random_entry(NULL);
+    bench_close();
+    for (int i = 0; i < n; i++) {
+        ui_t ui;
+        startup_begin();
+        if (ui_init(&ui, DEFAULT_ROWS, DEFAULT_COLS) == 0) {
+            ui.renderer.fd = out;
+            ui_start(&ui, config->path, BENCH_SOCKET_PATH);
+        }
+        samples[i] = startup_until(STARTUP_FIRST_FRAME);
+        ready[i] = startup_until(STARTUP_WRITER);
+        for (int phase = 0; phase < STARTUP_PHASES; phase++) {
+            phases[phase * n + i] = startup.phase_us[phase];
+        }
+        writer_stop();
+        ui_free(&ui);
+        finalize_read_stmts();
+        finalize_write_stmts();
+        sqlite3_close(WRITER_DB);
+        sqlite3_close(DB);
+        WRITER_DB = NULL;
+        DB = NULL;
+    }
+    startup.last_us = 0;
+    report(config, "startup", samples, n);
+    report(config, "startup_ready", ready, n);
+    for (int phase = 0; phase < STARTUP_PHASES; phase++) {
+        char op[64];
+        snprintf(op, sizeof(op), "startup_%s", startup_phase_names[phase]);
+        report(config, op, phases + phase * n, n);
+    }
+    free(phases);
+    free(ready);
+    close(out);
+    bench_open(config->path);
+}
+
+// One client process of bench_daemon: alternates loading the first page of today and toggling one of its
+// entries, then writes its latencies to out
+void bench_daemon_client(int requests, int out) {
+    int want = list_view_height(DEFAULT_ROWS, 0) + LIST_PREFETCH_ROWS;
+    entry_t *entries = malloc(sizeof(entry_t) * want);
+    double *samples = malloc(sizeof(double) * requests);
+    arena_t arena = {0};
+    int n = 0;
+    if (entries == NULL || samples == NULL || client_connect(BENCH_SOCKET_PATH) != 0) {
+        _exit(1);
+    }
+    for (int i = 0; i < requests; i++) {
+        double start = now_us();
+        if (i % 2 == 0 || n == 0) {
+            arena_reset(&arena);
+            client_load_entries(today(), NULL, NULL, 1, entries, want, &n, &arena);
+        } else {
+            entry_t *entry = &entries[rand() % n];
+            entry->completed = !entry->completed;
+            entry->updated_at = time(NULL);
+            client_push(WRITE_UPDATE, entry);
+        }
+        samples[i] = now_us() - start;
+    }
+    client_close();
+    _exit(write(out, samples, sizeof(double) * requests) != (ssize_t)(sizeof(double) * requests));
+}
+
+// Requests per second that 1, 4 and 16 client processes get out of one daemon serving the database
+void bench_daemon(const bench_config_t *config) {
+    static const int clients_counts[] = {1, 4, 16};
+    int requests = config->samples;
+    double *all = malloc(sizeof(double) * requests * 16);
+    random_entry(NULL);
+    bench_close();
+    unlink(BENCH_SOCKET_PATH);
+    pid_t daemon = fork();
+    if (daemon == 0) {
+        _exit(daemon_run(config->path, BENCH_SOCKET_PATH));
+    }
+    // Wait for the daemon to listen
+    int ready = 0;
+    for (int i = 0; i < 500 && !ready; i++) {
+        ready = client_connect(BENCH_SOCKET_PATH) == 0;
+        if (!ready) {
+            usleep(10000);
+        }
+    }
+    client_close();
+    for (size_t c = 0; ready && all != NULL && c < sizeof(clients_counts) / sizeof(clients_counts[0]); c++) {
+        int clients = clients_counts[c];
+        int fds[16];
+        pid_t pids[16];
+        int taken = 0;
+        double start = now_us();
+        for (int i = 0; i < clients; i++) {
+            int p[2];
+            if (pipe(p) != 0) {
+                clients = i;
+                break;
+            }
+            pids[i] = fork();
+            if (pids[i] == 0) {
+                close(p[0]);
+                srand(i + 1);
+                bench_daemon_client(requests, p[1]);
+            }
+            close(p[1]);
+            fds[i] = p[0];
+        }
+        for (int i = 0; i < clients; i++) {
+            char *dst = (char *)(all + taken);
+            size_t got = 0;
+            ssize_t r;
+            while ((r = read(fds[i], dst + got, sizeof(double) * requests - got)) > 0) {
+                got += r;
+            }
+            close(fds[i]);
+            waitpid(pids[i], NULL, 0);
+            taken += got / sizeof(double);
+        }
+        double seconds = (now_us() - start) / 1e6;
+        if (taken == 0) {
+            continue;
+        }
+        qsort(all, taken, sizeof(double), cmp_double);
+        int p99 = (int)ceil(taken * 0.99) - 1;
+        printf("{\"op\":\"daemon\",\"rows\":%ld,\"clients\":%d,\"requests\":%d,\"seconds\":%.3f,"
+               "\"requests_per_s\":%.0f,\"p50_us\":%.1f,\"p99_us\":%.1f}\n",
+               config->rows, clients, taken, seconds, taken / seconds, all[taken / 2], all[p99 < 0 ? 0 : p99]);
+        fflush(stdout);
+    }
+    if (!ready) {
+        fprintf(stderr, "[error] bench_daemon: the daemon did not start\n");
+    }
+    kill(daemon, SIGTERM);
+    waitpid(daemon, NULL, 0);
+    free(all);
+    bench_open(config->path);
+}
+
+// Runs the whole UI headless on a key script the way `tday --replay` does, writer thread included, with
+// the frames written to /dev/null. Reports the time from each key to its frame and the bytes written.
+void bench_replay_script(const bench_config_t *config, const char *op, const char *keys, size_t len) {
+    ui_t ui;
+    FILE *script = tmpfile();
+    int out = open("/dev/null", O_WRONLY);
+    if (script == NULL || out < 0 || fwrite(keys, 1, len, script) != len || fflush(script) != 0) {
+        fprintf(stderr, "[error] bench_replay: could not write the key script\n");
+        return;
+    }
+    rewind(script);
+    if (ui_init(&ui, DEFAULT_ROWS, DEFAULT_COLS) == 0 && open_db(config->path) == 0 &&
+        writer_start(config->path) == 0) {
+        ui.renderer.fd = out;
+        memset(&stats.key_to_flush, 0, sizeof(stats.key_to_flush));
+        double start = now_us();
+        long replayed = replay_keys(&ui, fileno(script));
+        double seconds = (now_us() - start) / 1e6;
+        const histogram_t *h = &stats.key_to_flush;
+        if (replayed > 0) {
+            printf("{\"op\":\"%s\",\"rows\":%ld,\"keys\":%ld,\"seconds\":%.3f,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+                   "\"max_us\":%.1f,\"bytes\":%zu,\"bytes_per_key\":%.1f,\"max_frame_bytes\":%zu}\n",
+                   op, config->rows, replayed, seconds, histogram_percentile(h, 0.5), histogram_percentile(h, 0.99),
+                   h->max_us, ui.renderer.total_bytes, (double)ui.renderer.total_bytes / replayed,
+                   ui.renderer.max_frame_bytes);
+            fflush(stdout);
+        }
+    }
+    writer_stop();
+    ui_free(&ui);
+    history_free();
+    finalize_read_stmts();
+    finalize_write_stmts();
+    sqlite3_close(WRITER_DB);
+    sqlite3_close(DB);
+    WRITER_DB = NULL;
+    DB = NULL;
+    fclose(script);
+    close(out);
+}
+
+// Latency of the UI loop itself, from key to written frame: scrolling down today's list, typing and
+// saving new tasks, and toggling every task of the first rows twice over, which leaves them as they were
+void bench_replay(const bench_config_t *config) {
+    size_t cap = BENCH_REPLAY_NEW_TASKS * 32 + BENCH_REPLAY_TOGGLE_ROWS * 5 + BENCH_REPLAY_SCROLL_ROWS;
+    char *keys = malloc(cap);
+    size_t len = 0;
+    if (keys == NULL) {
+        return;
+    }
+    random_entry(NULL);
+    bench_close();
+
+    memset(keys, 'j', BENCH_REPLAY_SCROLL_ROWS);
+    bench_replay_script(config, "replay_scroll", keys, BENCH_REPLAY_SCROLL_ROWS);
+
+    for (int i = 0; i < BENCH_REPLAY_NEW_TASKS; i++) {
+        len += snprintf(keys + len, cap - len, "nreplay task %d\n", i);
+    }
+    bench_replay_script(config, "replay_new_tasks", keys, len);
+
+    len = 0;
+    for (int i = 0; i < BENCH_REPLAY_TOGGLE_ROWS; i++) {
+        keys[len++] = '\n';
+        keys[len++] = 'j';
+    }
+    memset(keys + len, 'k', BENCH_REPLAY_TOGGLE_ROWS);
+    len += BENCH_REPLAY_TOGGLE_ROWS;
+    memcpy(keys + len, keys, BENCH_REPLAY_TOGGLE_ROWS * 2);
+    len += BENCH_REPLAY_TOGGLE_ROWS * 2;
+    bench_replay_script(config, "replay_toggle", keys, len);
+    free(keys);
+
+    // Take the typed tasks out again, so the database keeps its shape between runs
+    bench_open(config->path);
+    sqlite3_exec(DB, "DELETE FROM entries WHERE description GLOB 'replay task *';", NULL, NULL, NULL);
+}
+
+void bench_usage(void) {
+    fprintf(stderr, "usage: tday-bench [options]\n"
+                    "\n"
+                    "  -n rows        rows to generate, default 100000\n"
+                    "  -c ratio       fraction of completed tasks, default 0.3\n"
+                    "  -i ratio       fraction of cleared (ignored) tasks, default 0.5\n"
+                    "  -u ratio       fraction of tasks with an updated_at, default 0.7\n"
+                    "  -s days        span of updated_at timestamps, default 365\n"
+                    "  -d dist        updated_at distribution, uniform or recent, default recent\n"
+                    "  -r samples     samples per operation, default 1000\n"
+                    "  -o path        database path, default " BENCH_DB_PATH "\n"
+                    "  -k             keep and reuse an existing database at path\n"
+                    "  -p             check the list query plans on a fresh database at path and exit,\n"
+                    "                 failing when one of them scans or sorts\n");
+}
+
+int main(int argc, char **argv) {
+    bench_config_t config = {
+        .rows = 100000,
+        .completed_ratio = 0.3,
+        .ignored_ratio = 0.5,
+        .updated_ratio = 0.7,
+        .updated_span_days = 365,
+        .updated_distribution = UPDATED_RECENT,
+        .samples = 1000,
+        .path = BENCH_DB_PATH,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:i:u:s:d:r:o:kph")) != -1) {
+        switch (opt) {
+        case 'n':
+            config.rows = strtol(optarg, NULL, 10);
+            break;
+        case 'c':
+            config.completed_ratio = strtod(optarg, NULL);
+            break;
+        case 'i':
+            config.ignored_ratio = strtod(optarg, NULL);
+            break;
+        case 'u':
+            config.updated_ratio = strtod(optarg, NULL);
+            break;
+        case 's':
+            config.updated_span_days = atoi(optarg);
+            break;
+        case 'd':
+            config.updated_distribution = strcmp(optarg, "uniform") == 0 ? UPDATED_UNIFORM : UPDATED_RECENT;
+            break;
+        case 'r':
+            config.samples = atoi(optarg);
+            break;
+        case 'o':
+            config.path = optarg;
+            break;
+        case 'k':
+            config.keep = 1;
+            break;
+        case 'p':
+            config.check_plan = 1;
+            break;
+        default:
+            bench_usage();
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (config.samples <= 0) {
+        config.samples = 1;
+    }
+    srand(42);
+
+    if (!config.keep || config.check_plan) {
+        char path[1024];
+        unlink(config.path);
+        snprintf(path, sizeof(path), "%s-wal", config.path);
+        unlink(path);
+        snprintf(path, sizeof(path), "%s-shm", config.path);
+        unlink(path);
+    }
+    if (bench_open(config.path) != 0) {
+        return 1;
+    }
+    if (config.check_plan) {
+        int offending = check_list_query_plan();
+        bench_close();
+        if (offending != 0) {
+            fprintf(stderr, "[error] check_list_query_plan: %d list queries scan or sort\n", offending);
+            return 1;
+        }
+        fprintf(stderr, "list query plans ok\n");
+        return 0;
+    }
+    if (!config.keep && generate(&config) != 0) {
+        bench_close();
+        return 1;
+    }
+    // Pick up the ids the generator used
+    bench_close();
+    if (bench_open(config.path) != 0) {
+        return 1;
+    }
+
+    double *samples = malloc(sizeof(double) * config.samples);
+    bench_load_entries(&config, samples);
+    bench_mutations(&config, samples);
+    bench_clear_completed(&config, samples);
+    bench_rollover(&config, samples);
+    bench_moves(&config, samples);
+    bench_activity(&config, samples);
+    bench_filter(&config, samples);
+    bench_sync(&config, samples);
+    bench_startup(&config, samples);
+    bench_replay(&config);
+    bench_daemon(&config);
+    free(samples);
+
+    random_entry(NULL);
+    bench_close();
+    return 0;
+}
@@ -1 +1,13 @@
 #define db_file_path "tday.db"
+
+// Where tday writes its performance stats on exit
+#define stats_file_path "tday.stats"
+
+// Where cleared tasks are moved to, see `tday archive`
+#define archive_file_path "tday-archive.db"
+
+// Archived tasks older than this many days are deleted, 0 keeps them forever
+#define archive_retention_days 0
+
+// Where `tday --daemon` listens, and where the interactive list looks for it
+#define socket_file_path "tday.sock"
@@ -1,15 +1,41 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <sqlite3.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "config.h"
 
-#define STRIKETHROUGH "\e[9m"
-#define RESET_FMT "\e[0m"
+#ifndef stats_file_path
+#define stats_file_path "tday.stats"
+#endif
+
+#ifndef archive_file_path
+#define archive_file_path "tday-archive.db"
+#endif
+
+#ifndef socket_file_path
+#define socket_file_path "tday.sock"
+#endif
+
+#ifndef archive_retention_days
+#define archive_retention_days 0
+#endif
 
 void set_raw_mode(struct termios *old_termios) {
     struct termios new_termios;
@@ -29,589 +55,7239 @@ void set_raw_mode(struct termios *old_termios) {
 
     // Apply new settings
     tcsetattr(STDIN_FILENO, TCSANOW, &new_termios);
+
+    // Enable bracketed paste, pasted text arrives between \e[200~ and \e[201~
+    write(STDOUT_FILENO, "\e[?2004h", 8);
 }
 
-void restore_terminal_mode(struct termios *tio) { tcsetattr(STDIN_FILENO, TCSANOW, tio); }
+void restore_terminal_mode(struct termios *tio) {
+    write(STDOUT_FILENO, "\e[?2004l", 8);
+    tcsetattr(STDIN_FILENO, TCSANOW, tio);
+}
 
-#define zero_array(arr, n)            \
-    do {                              \
-        for (int i = 0; i < n; i++) { \
-            arr[i] = 0;               \
-        }                             \
-    } while (0)
+// Input
+//
+// Everything available on stdin is read at once and parsed into keys, so a burst of typing or a
+// paste is applied before a single render instead of one frame per byte. Escape sequences split
+// across reads are kept until their tail arrives, and bracketed paste delivers pasted text as one
+// KEY_PASTE.
 
-#define zero_buf(buf, size, cursor)         \
-    do {                                    \
-        zero_array(buf, MAX_STRING_LENGTH); \
-        (*size) = 0;                        \
-        (*cursor) = 0;                      \
-    } while (0)
+#define INPUT_BUF_SIZE 4096
+#define ESCAPE_TIMEOUT_MS 25
 
-#define return_defer(value) \
-    do {                    \
-        (result) = value;   \
-        goto defer;         \
-    } while (0)
+// Plain bytes are returned as themselves, everything else after 255
+enum {
+    KEY_NONE = -1,
+    KEY_CTRL_R = 18,
+    KEY_ESCAPE = 27,
+    KEY_BACKSPACE = 127,
+    KEY_ARROW_UP = 256,
+    KEY_ARROW_DOWN,
+    KEY_ARROW_RIGHT,
+    KEY_ARROW_LEFT,
+    KEY_HOME,
+    KEY_END,
+    KEY_DELETE,
+    KEY_PASTE,
+};
 
-#define check_db_err(db_err, ctx)                                         \
-    do {                                                                  \
-        if ((db_err) != SQLITE_OK) {                                      \
-            fprintf(stderr, "[error] " ctx ": %s\n", sqlite3_errmsg(DB)); \
-            return_defer(1);                                              \
-        }                                                                 \
-    } while (0)
+typedef struct Input {
+    int fd; // the terminal, or a key script being replayed
+    char buf[INPUT_BUF_SIZE];
+    int len;
+    int pos;
+    int in_paste;
+    int closed; // fd reached end of file or failed
+    char *paste; // text of the last KEY_PASTE, not NUL terminated
+    size_t paste_len;
+    size_t paste_cap;
+} input_t;
 
-#define MAX_SELECTION (entries_in_view - 1)
-#define MAX_ENTRIES_IN_VIEW 10
-#define MAX_STRING_LENGTH 64
+void input_init(input_t *in, int fd) {
+    memset(in, 0, sizeof(*in));
+    in->fd = fd;
+}
 
-typedef enum CurrentView { LIST_VIEW, NEW_ENTRY_VIEW, EDIT_ENTRY_VIEW } current_view_t;
+void input_free(input_t *in) { free(in->paste); }
 
-typedef struct Entry {
-    int id;
-    int completed;
-    int ignored;
-    char description[MAX_STRING_LENGTH];
-} entry_t;
+void input_paste_append(input_t *in, char ch) {
+    if (in->paste_len == in->paste_cap) {
+        size_t cap = in->paste_cap ? in->paste_cap * 2 : 256;
+        char *paste = realloc(in->paste, cap);
+        if (paste == NULL) {
+            return;
+        }
+        in->paste = paste;
+        in->paste_cap = cap;
+    }
+    in->paste[in->paste_len++] = ch;
+}
 
-#define create_table_entries_sql          \
-    "CREATE TABLE IF NOT EXISTS entries(" \
-    "id INTEGER PRIMARY KEY, "            \
-    "description TEXT NOT NULL, "         \
-    "completed INTEGER DEFAULT(0), "      \
-    "ignored INTEGER DEFAULT(0)"          \
-    ");"
+// Length of the escape sequence at s, 0 if it is cut off before its final byte
+int escape_seq_len(const char *s, int n) {
+    if (n < 2) {
+        return 0;
+    }
+    if (s[1] == 'O') {
+        return n < 3 ? 0 : 3;
+    }
+    if (s[1] != '[') {
+        return 1; // a lone ESC followed by a regular key
+    }
+    for (int i = 2; i < n; i++) {
+        if (s[i] >= 0x40 && s[i] <= 0x7e) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
 
-#define migrate_table_entries_v1_sql "ALTER TABLE entries ADD COLUMN updated_at INTEGER;"
+// Whether the unparsed input ends in the middle of an escape sequence
+int input_incomplete(const input_t *in) {
+    for (int i = in->len - 1; i >= in->pos && i >= in->len - 16; i--) {
+        if (in->buf[i] == '\e') {
+            return escape_seq_len(in->buf + i, in->len - i) == 0;
+        }
+    }
+    return 0;
+}
 
-#define get_entries_sql \
-    "SELECT * FROM entries WHERE ignored = 0 ORDER BY completed ASC, updated_at DESC, id DESC LIMIT 10;"
+// Blocks until fd has something, then reads all of it
+int input_read(input_t *in) {
+    if (in->pos > 0) {
+        memmove(in->buf, in->buf + in->pos, in->len - in->pos);
+        in->len -= in->pos;
+        in->pos = 0;
+    }
+    ssize_t n = read(in->fd, in->buf + in->len, INPUT_BUF_SIZE - in->len);
+    if (n <= 0) {
+        return 1;
+    }
+    in->len += n;
+    // A terminal writes a sequence at once, so its tail follows shortly. If nothing comes the ESC
+    // was pressed on its own.
+    struct pollfd pfd = {.fd = in->fd, .events = POLLIN};
+    while (input_incomplete(in) && in->len < INPUT_BUF_SIZE && poll(&pfd, 1, ESCAPE_TIMEOUT_MS) > 0) {
+        n = read(in->fd, in->buf + in->len, INPUT_BUF_SIZE - in->len);
+        if (n <= 0) {
+            break;
+        }
+        in->len += n;
+    }
+    return 0;
+}
 
-#define insert_entry_sql                 \
-    "INSERT INTO entries (description) " \
-    "VALUES (?);"
+// Returns the next key from the bytes read so far, or KEY_NONE once they are used up
+int input_next(input_t *in) {
+    while (in->pos < in->len) {
+        char *s = in->buf + in->pos;
+        int n = in->len - in->pos;
+        if (s[0] != '\e') {
+            in->pos++;
+            if (!in->in_paste) {
+                return (unsigned char)s[0];
+            }
+            if (s[0] == '\n' || s[0] == '\r' || s[0] == '\t') {
+                input_paste_append(in, ' ');
+            } else if ((unsigned char)s[0] >= ' ') {
+                input_paste_append(in, s[0]);
+            }
+            continue;
+        }
 
-#define update_entry_sql                                                            \
-    "UPDATE entries "                                                               \
-    "SET description = ?, completed = ?, ignored = ?, updated_at = strftime('%s') " \
-    "WHERE id = ?;"
+        int len = escape_seq_len(s, n);
+        if (len == 0) {
+            if (in->in_paste || n > 1) {
+                return KEY_NONE; // wait for the rest of the sequence
+            }
+            len = 1;
+        }
+        in->pos += len;
+        if (len == 6 && memcmp(s, "\e[200~", 6) == 0) {
+            in->in_paste = 1;
+            in->paste_len = 0;
+            continue;
+        }
+        if (len == 6 && memcmp(s, "\e[201~", 6) == 0) {
+            in->in_paste = 0;
+            return KEY_PASTE;
+        }
+        if (in->in_paste) {
+            continue;
+        }
+        if (len == 1) {
+            return KEY_ESCAPE;
+        }
+        switch (s[len - 1]) {
+        case 'A':
+            return KEY_ARROW_UP;
+        case 'B':
+            return KEY_ARROW_DOWN;
+        case 'C':
+            return KEY_ARROW_RIGHT;
+        case 'D':
+            return KEY_ARROW_LEFT;
+        case 'H':
+            return KEY_HOME;
+        case 'F':
+            return KEY_END;
+        case '~':
+            // \e[1~ and \e[7~ are home, \e[4~ and \e[8~ end, \e[3~ delete
+            if (len == 4 && (s[2] == '1' || s[2] == '7')) {
+                return KEY_HOME;
+            }
+            if (len == 4 && (s[2] == '4' || s[2] == '8')) {
+                return KEY_END;
+            }
+            if (len == 4 && s[2] == '3') {
+                return KEY_DELETE;
+            }
+            break;
+        }
+    }
+    return KEY_NONE;
+}
 
-#define delete_entry_sql "DELETE FROM entries WHERE id = ?;"
+// Event loop
+//
+// The UI thread waits in a single poll() on stdin, the writer's notification pipe and the next
+// timer, instead of blocking in read() until the next key. Timers live in a hashed timing wheel:
+// starting, stopping and expiring one is O(1), and the wheel only wakes the thread when a timer is
+// actually due. Work queued with loop_post() runs once nothing is waiting on stdin, one task per
+// pass, so a key typed meanwhile waits for at most one task.
 
-#define clear_completed_entries_sql "UPDATE entries SET ignored = 1 WHERE completed = 1;"
+#define LOOP_MAX_WATCHES 4
+#define LOOP_TICK_MS 10
+#define LOOP_WHEEL_SLOTS 256
+#define LOOP_TASKS_CAP 32
 
-sqlite3 *DB;
-sqlite3_stmt *get_entries_stmt = NULL;
-sqlite3_stmt *insert_entry_stmt = NULL;
-sqlite3_stmt *update_entry_stmt = NULL;
-sqlite3_stmt *delete_entry_stmt = NULL;
-sqlite3_stmt *clear_completed_entries_stmt = NULL;
+typedef struct Loop loop_t;
+typedef void (*loop_fn_t)(loop_t *loop, void *ctx);
 
-int get_db_version(int *db_version) {
-    int result = 0;
-    sqlite3_stmt *stmt = NULL;
-    result = sqlite3_prepare_v2(DB, "PRAGMA user_version;", -1, &stmt, 0);
-    if (result != SQLITE_OK) {
-        return_defer(result);
+typedef struct LoopTimer {
+    loop_fn_t fn;
+    void *ctx;
+    uint64_t due;  // tick the timer fires at
+    int period_ms; // 0 for a one-shot timer
+    int active;
+    struct LoopTimer *next;
+    struct LoopTimer **prev; // the pointer that points at this timer, for O(1) removal
+} loop_timer_t;
+
+typedef struct LoopTask {
+    loop_fn_t fn;
+    void *ctx;
+} loop_task_t;
+
+struct Loop {
+    struct pollfd fds[LOOP_MAX_WATCHES];
+    loop_task_t watchers[LOOP_MAX_WATCHES];
+    int watches;
+    loop_timer_t *wheel[LOOP_WHEEL_SLOTS];
+    uint64_t tick; // every timer due at or before it has fired
+    int timers;
+    loop_task_t tasks[LOOP_TASKS_CAP];
+    int tasks_head;
+    int tasks_count;
+    int redraw; // set by callbacks whose work changed what is on screen
+};
+
+uint64_t loop_now_tick(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000) / LOOP_TICK_MS;
+}
+
+void loop_init(loop_t *loop) {
+    memset(loop, 0, sizeof(*loop));
+    loop->tick = loop_now_tick();
+}
+
+// Calls fn whenever fd is readable
+int loop_watch(loop_t *loop, int fd, loop_fn_t fn, void *ctx) {
+    if (loop->watches == LOOP_MAX_WATCHES) {
+        return 1;
     }
-    result = sqlite3_step(stmt);
-    if (result != SQLITE_ROW) {
-        return_defer(result);
+    loop->fds[loop->watches] = (struct pollfd){.fd = fd, .events = POLLIN};
+    loop->watchers[loop->watches] = (loop_task_t){.fn = fn, .ctx = ctx};
+    loop->watches++;
+    return 0;
+}
+
+void loop_timer_stop(loop_t *loop, loop_timer_t *timer) {
+    if (!timer->active) {
+        return;
     }
-    (*db_version) = sqlite3_column_int(stmt, 0);
-    result = sqlite3_step(stmt);
-    if (result != SQLITE_DONE) {
-        return_defer(result);
+    *timer->prev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->prev = timer->prev;
     }
-    return_defer(0);
-defer:
-    sqlite3_finalize(stmt);
-    return result;
+    timer->active = 0;
+    loop->timers--;
 }
 
-int load_entries(entry_t *entries, int *entries_sz) {
-    int result;
-    result = sqlite3_step(get_entries_stmt);
-    while (result == SQLITE_ROW) {
-        entry_t entry = {0};
-        entry.id = sqlite3_column_int(get_entries_stmt, 0);
-        const unsigned char *description = sqlite3_column_text(get_entries_stmt, 1);
-        int i = 0;
-        for (; i < sqlite3_column_bytes(get_entries_stmt, 1); i++) {
-            entry.description[i] = description[i];
+void loop_timer_insert(loop_t *loop, loop_timer_t *timer, uint64_t due) {
+    loop_timer_t **slot = &loop->wheel[due % LOOP_WHEEL_SLOTS];
+    timer->due = due;
+    timer->next = *slot;
+    timer->prev = slot;
+    if (*slot != NULL) {
+        (*slot)->prev = &timer->next;
+    }
+    *slot = timer;
+    timer->active = 1;
+    loop->timers++;
+}
+
+// Calls fn once after ms, then every period_ms if it is not 0. Starting an active timer moves it.
+void loop_timer_start(loop_t *loop, loop_timer_t *timer, int ms, int period_ms, loop_fn_t fn, void *ctx) {
+    loop_timer_stop(loop, timer);
+    timer->fn = fn;
+    timer->ctx = ctx;
+    timer->period_ms = period_ms;
+    uint64_t now = loop_now_tick();
+    uint64_t ticks = (ms + LOOP_TICK_MS - 1) / LOOP_TICK_MS;
+    loop_timer_insert(loop, timer, (now > loop->tick ? now : loop->tick) + (ticks > 0 ? ticks : 1));
+}
+
+// Queues fn to run once the UI is idle. A task that is already queued is not queued twice.
+int loop_post(loop_t *loop, loop_fn_t fn, void *ctx) {
+    for (int i = 0; i < loop->tasks_count; i++) {
+        loop_task_t *task = &loop->tasks[(loop->tasks_head + i) % LOOP_TASKS_CAP];
+        if (task->fn == fn && task->ctx == ctx) {
+            return 0;
         }
-        entry.description[i] = '\0';
+    }
+    if (loop->tasks_count == LOOP_TASKS_CAP) {
+        return 1;
+    }
+    loop->tasks[(loop->tasks_head + loop->tasks_count) % LOOP_TASKS_CAP] = (loop_task_t){.fn = fn, .ctx = ctx};
+    loop->tasks_count++;
+    return 0;
+}
 
-        entry.completed = sqlite3_column_int(get_entries_stmt, 2);
-        entries[(*entries_sz)++] = entry;
-        result = sqlite3_step(get_entries_stmt);
+// Milliseconds until the next timer is due, -1 without timers. The slots are scanned in the order
+// they come due, so the first timer found in its own lap of the wheel is the nearest one.
+int loop_timeout(loop_t *loop) {
+    if (loop->timers == 0) {
+        return -1;
     }
-    if (result != SQLITE_DONE) {
-        fprintf(stderr, "[error] step_get_entries_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(result);
+    uint64_t next = UINT64_MAX;
+    for (uint64_t t = loop->tick + 1; t <= loop->tick + LOOP_WHEEL_SLOTS && next > t; t++) {
+        for (loop_timer_t *timer = loop->wheel[t % LOOP_WHEEL_SLOTS]; timer != NULL; timer = timer->next) {
+            if (timer->due < next) {
+                next = timer->due;
+            }
+        }
     }
-    return_defer(0);
-defer:
-    sqlite3_reset(get_entries_stmt);
-    return result;
+    uint64_t now = loop_now_tick();
+    return next <= now ? 0 : (int)((next - now) * LOOP_TICK_MS);
 }
 
-int new_entry(char *description) {
-    int result;
-    result = sqlite3_bind_text(insert_entry_stmt, 1, description, -1, SQLITE_STATIC);
-    if (result != SQLITE_OK) {
-        fprintf(stderr, "[error] bind_insert_entry_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(result);
+// Fires every timer that came due since the last call
+void loop_expire_timers(loop_t *loop) {
+    uint64_t now = loop_now_tick();
+    if (now - loop->tick > LOOP_WHEEL_SLOTS) {
+        loop->tick = now - LOOP_WHEEL_SLOTS; // each slot only needs to be looked at once
     }
-    result = sqlite3_step(insert_entry_stmt);
-    if (result != SQLITE_DONE) {
-        fprintf(stderr, "[error] step_insert_entry_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(1);
+    while (loop->tick < now && loop->timers > 0) {
+        loop->tick++;
+        loop_timer_t *timer = loop->wheel[loop->tick % LOOP_WHEEL_SLOTS];
+        while (timer != NULL) {
+            loop_timer_t *next = timer->next;
+            if (timer->due <= now) {
+                loop_timer_stop(loop, timer);
+                if (timer->period_ms > 0) {
+                    loop_timer_insert(loop, timer, now + (timer->period_ms + LOOP_TICK_MS - 1) / LOOP_TICK_MS);
+                }
+                timer->fn(loop, timer->ctx);
+            }
+            timer = next;
+        }
     }
-defer:
-    sqlite3_clear_bindings(insert_entry_stmt);
-    sqlite3_reset(insert_entry_stmt);
-    return result;
+    loop->tick = now;
 }
 
-int update_entry(entry_t *entry) {
-    int result;
-    result = sqlite3_bind_text(update_entry_stmt, 1, entry->description, -1, SQLITE_STATIC);
-    if (result != SQLITE_OK) {
-        fprintf(stderr, "[error] bind_description_update_entry_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(result);
+// Waits for the next event and handles whatever is ready: readable fds, due timers and, when stdin
+// had nothing waiting, one queued task. Returns 1 if poll() failed.
+int loop_run_once(loop_t *loop) {
+    int timeout = loop->tasks_count > 0 ? 0 : loop_timeout(loop);
+    int ready = poll(loop->fds, loop->watches, timeout);
+    if (ready < 0) {
+        return errno != EINTR;
     }
-    result = sqlite3_bind_int(update_entry_stmt, 2, entry->completed);
-    if (result != SQLITE_OK) {
-        fprintf(stderr, "[error] bind_completed_update_entry_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(result);
+    for (int i = 0; i < loop->watches && ready > 0; i++) {
+        if (loop->fds[i].revents != 0) {
+            loop->watchers[i].fn(loop, loop->watchers[i].ctx);
+        }
     }
-    result = sqlite3_bind_int(update_entry_stmt, 3, entry->ignored);
-    if (result != SQLITE_OK) {
-        fprintf(stderr, "[error] bind_completed_update_entry_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(result);
+    loop_expire_timers(loop);
+    if (ready == 0 && loop->tasks_count > 0) {
+        loop_task_t task = loop->tasks[loop->tasks_head];
+        loop->tasks_head = (loop->tasks_head + 1) % LOOP_TASKS_CAP;
+        loop->tasks_count--;
+        task.fn(loop, task.ctx);
     }
-    result = sqlite3_bind_int(update_entry_stmt, 4, entry->id);
-    if (result != SQLITE_OK) {
-        fprintf(stderr, "[error] bind_where_id_update_entry_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(result);
+    return 0;
+}
+
+// Renderer
+//
+// Every view draws into an off-screen cell buffer (the back frame). render_flush() diffs it
+// against what is currently on the terminal (the front frame) and sends only the changed
+// cells, attribute changes and cursor moves, in a single write().
+
+#define ATTR_NONE 0
+#define ATTR_YELLOW (1 << 0)
+#define ATTR_STRIKETHROUGH (1 << 1)
+
+#define DEFAULT_ROWS 24
+#define DEFAULT_COLS 80
+
+typedef struct Cell {
+    char ch[4]; // UTF-8 encoded codepoint
+    unsigned char len;
+    unsigned char attr;
+} cell_t;
+
+typedef struct Frame {
+    int rows;
+    int cols;
+    cell_t *cells;
+    int cursor_row; // -1 hides the cursor
+    int cursor_col;
+} frame_t;
+
+typedef struct Renderer {
+    frame_t front;
+    frame_t back;
+    int force_full;
+    int fd; // frames are written to it: the terminal, or whatever captures a replay
+    char *out;
+    size_t out_len;
+    size_t out_cap;
+    size_t frames;
+    size_t last_frame_bytes;
+    size_t max_frame_bytes;
+    size_t total_bytes;
+    size_t write_calls;
+} renderer_t;
+
+static const cell_t blank_cell = {{' ', 0, 0, 0}, 1, ATTR_NONE};
+
+int frame_init(frame_t *frame, int rows, int cols) {
+    frame->cells = malloc(sizeof(cell_t) * rows * cols);
+    if (frame->cells == NULL) {
+        return 1;
     }
-    result = sqlite3_step(update_entry_stmt);
-    if (result != SQLITE_DONE) {
-        fprintf(stderr, "[error] step_update_entry_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(result);
+    frame->rows = rows;
+    frame->cols = cols;
+    frame->cursor_row = -1;
+    frame->cursor_col = 0;
+    for (int i = 0; i < rows * cols; i++) {
+        frame->cells[i] = blank_cell;
     }
-    return_defer(0);
-defer:
-    sqlite3_reset(update_entry_stmt);
-    sqlite3_clear_bindings(update_entry_stmt);
-    return result;
+    return 0;
 }
 
-int delete_entry(entry_t *entry) {
-    int result;
-    result = sqlite3_bind_int(delete_entry_stmt, 1, entry->id);
-    if (result != SQLITE_OK) {
-        fprintf(stderr, "[error] bind_where_id_delete_entry_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(result);
+void frame_clear(frame_t *frame) {
+    for (int i = 0; i < frame->rows * frame->cols; i++) {
+        frame->cells[i] = blank_cell;
     }
-    result = sqlite3_step(delete_entry_stmt);
-    if (result != SQLITE_DONE) {
-        fprintf(stderr, "[error] step_delete_entry_stmt: %s\n", sqlite3_errmsg(DB));
-        return_defer(result);
+    frame->cursor_row = -1;
+    frame->cursor_col = 0;
+}
+
+int cell_eq(const cell_t *a, const cell_t *b) {
+    return a->len == b->len && a->attr == b->attr && memcmp(a->ch, b->ch, a->len) == 0;
+}
+
+void get_terminal_size(int *rows, int *cols) {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        (*rows) = ws.ws_row;
+        (*cols) = ws.ws_col;
+    } else {
+        (*rows) = DEFAULT_ROWS;
+        (*cols) = DEFAULT_COLS;
     }
-    return_defer(0);
-defer:
-    sqlite3_reset(delete_entry_stmt);
-    sqlite3_clear_bindings(delete_entry_stmt);
-    return result;
 }
 
-int main(void) {
-    int result = 0;
-    int entries_sz = 0;
-    int current_selection = 0;
-    int entries_in_view = 0;
-    entry_t entries[MAX_ENTRIES_IN_VIEW] = {0};
+// The SIGWINCH handler only writes a byte to resize_pipe[1]; the event loop watches the other end and
+// does the actual work outside of signal context
+int resize_pipe[2] = {-1, -1};
 
-    struct termios old_tio;
-    set_raw_mode(&old_tio);
+void on_sigwinch(int sig) {
+    (void)sig;
+    int saved_errno = errno;
+    // A full pipe already holds a pending resize
+    write(resize_pipe[1], "", 1);
+    errno = saved_errno;
+}
 
-    check_db_err(sqlite3_open(db_file_path, &DB), "sqlite3_open");
-    check_db_err(sqlite3_exec(DB, create_table_entries_sql, NULL, 0, NULL), "create_table_entries");
+int resize_signal_init(void) {
+    if (pipe(resize_pipe) != 0 || fcntl(resize_pipe[0], F_SETFL, O_NONBLOCK) != 0 ||
+        fcntl(resize_pipe[1], F_SETFL, O_NONBLOCK) != 0) {
+        return 1;
+    }
+    struct sigaction sa = {0};
+    sa.sa_handler = on_sigwinch;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    return sigaction(SIGWINCH, &sa, NULL) != 0;
+}
 
-    int db_version;
-    check_db_err(get_db_version(&db_version), "get_db_version");
-    if (db_version == 0) {
-        sqlite3_exec(DB, "BEGIN TRANSACTION;", NULL, NULL, NULL);
-        check_db_err(sqlite3_exec(DB, migrate_table_entries_v1_sql, NULL, 0, NULL), "migrate_table_entries_v1");
-        check_db_err(sqlite3_exec(DB, "PRAGMA user_version = 1;", NULL, 0, NULL), "db_version_to_1");
-        sqlite3_exec(DB, "END TRANSACTION;", NULL, NULL, NULL);
-    }
-
-    check_db_err(sqlite3_prepare_v2(DB, get_entries_sql, -1, &get_entries_stmt, 0), "prepare_get_entries_stmt");
-    check_db_err(sqlite3_prepare_v2(DB, insert_entry_sql, -1, &insert_entry_stmt, 0), "prepare_insert_entry_stmt");
-    check_db_err(sqlite3_prepare_v2(DB, update_entry_sql, -1, &update_entry_stmt, 0), "prepare_update_entry_stmt");
-    check_db_err(sqlite3_prepare_v2(DB, delete_entry_sql, -1, &delete_entry_stmt, 0), "prepare_delete_entry_stmt");
-    check_db_err(sqlite3_prepare_v2(DB, clear_completed_entries_sql, -1, &clear_completed_entries_stmt, 0),
-                 "prepare_clear_completed_entries_stmt");
-
-    current_view_t current_view = LIST_VIEW;
-
-    char new_entry_buf[MAX_STRING_LENGTH];
-    zero_array(new_entry_buf, MAX_STRING_LENGTH);
-    int new_entry_buf_size = 0;
-    int new_entry_buf_cursor = new_entry_buf_size;
-
-    char edit_entry_buf[MAX_STRING_LENGTH];
-    zero_array(edit_entry_buf, MAX_STRING_LENGTH);
-    int edit_entry_buf_size = 0;
-    int edit_entry_buf_cursor = edit_entry_buf_size;
-
-    char input_handle_buf[3];
-    zero_array(input_handle_buf, 3);
-
-    char *buf = NULL;
-    int *buf_size = NULL;
-    int *buf_cursor = NULL;
-    int buf_noop = 1;
-
-    int should_reload_entries = 1;
-    while (1) {
-        if (should_reload_entries) {
-            for (int i = 0; i < entries_sz; i++) {
-                entries[i].id = 0;
-                entries[i].completed = 0;
-                entries[i].ignored = 0;
-                int len = strlen(entries[i].description);
-                for (int i = 0; i < len; i++) {
-                    entries[i].description[i] = 0;
-                }
-                entries[i].description[0] = '\0';
-            }
-            entries_sz = 0;
-            load_entries(entries, &entries_sz);
-            entries_in_view = entries_sz > MAX_ENTRIES_IN_VIEW ? MAX_ENTRIES_IN_VIEW : entries_sz;
-            should_reload_entries = 0;
-        }
+int renderer_init(renderer_t *r, int rows, int cols) {
+    memset(r, 0, sizeof(*r));
+    if (frame_init(&r->front, rows, cols) != 0 || frame_init(&r->back, rows, cols) != 0) {
+        return 1;
+    }
+    r->force_full = 1;
+    r->fd = STDOUT_FILENO;
+    return 0;
+}
 
-        switch (current_view) {
-        case LIST_VIEW:
-            // > tday
-            //
-            // [ ] work on tday
-            // [ ] study opengl
-            // [ ] read japanese
-            //
-            // up (k) / down (j) to move selection
-            // space/enter to toggle completed status
-            // (n)ew entry (e)dit (d)elete, (x) to clear completed
-            // escape to (q)uit
-            printf("\e[2J"); // Clear entire screen
-            printf("\e[H");  // Move cursor to top-left
-            printf("tday\n\n");
-            for (int i = 0; i < entries_in_view; i++) {
-                if (current_selection == i) {
-                    printf("\e[33m> " RESET_FMT);
-                } else {
-                    printf("  ");
-                }
-                if (entries[i].completed) {
-                    printf("[x] " STRIKETHROUGH);
-                } else {
-                    printf("[ ] ");
-                }
-                printf("%s" RESET_FMT "\n", entries[i].description);
-            }
-            if (entries_in_view == 0) {
-                printf("no entries yet\n");
-            }
-            printf("\n");
-            printf("up (k) / down (j) to move selection\n"
-                   "space/enter to toggle completed status\n"
-                   "(n)ew entry, (e)dit, (d)elete, (x) to clear completed\n"
-                   "escape to (q)uit\n");
-            break;
-        case NEW_ENTRY_VIEW:
-            // > tday
-            //
-            // new task description:
-            // >
-            //
-            // enter to save, escape to go back
-            printf("\e[2J"); // Clear entire screen
-            printf("\e[H");  // Move cursor to top-left
-            printf("tday\n\n");
-            printf("new task description:\n");
-            printf("\e[6;0H");
-            printf("enter to save, escape to go back\n");
-            printf("\e[4;0H");
-            printf("> %.*s", new_entry_buf_size, new_entry_buf);
-            printf("\e[4;%dH", new_entry_buf_cursor + 3);
-            break;
-        case EDIT_ENTRY_VIEW:
-            // > tday
-            //
-            // description: %
-            // > %
-            //
-            // enter to save, escape to discard changes
-            printf("\e[2J"); // Clear entire screen
-            printf("\e[H");  // Move cursor to top-left
-            printf("tday\n\n");
-            printf("description: %s\n", entries[current_selection].description);
-            printf("\e[6;0H");
-            printf("enter to save, escape to discard changes\n");
-            printf("\e[4;0H");
-            printf("> %.*s", edit_entry_buf_size, edit_entry_buf);
-            printf("\e[4;%dH", edit_entry_buf_cursor + 3);
-            break;
-        }
-        fflush(stdout);
-
-        switch (current_view) {
-        case LIST_VIEW:
-            buf = NULL;
-            buf_size = NULL;
-            buf_cursor = NULL;
-            buf_noop = 1;
-        case NEW_ENTRY_VIEW:
-            buf = new_entry_buf;
-            buf_size = &new_entry_buf_size;
-            buf_cursor = &new_entry_buf_cursor;
-            buf_noop = 0;
+void renderer_free(renderer_t *r) {
+    free(r->front.cells);
+    free(r->back.cells);
+    free(r->out);
+}
+
+// Resizes both frames to the new terminal size. The terminal has reflowed whatever was on it, so
+// the next flush repaints the whole screen.
+int renderer_resize(renderer_t *r, int rows, int cols) {
+    frame_t front, back;
+    if (frame_init(&front, rows, cols) != 0) {
+        return 1;
+    }
+    if (frame_init(&back, rows, cols) != 0) {
+        free(front.cells);
+        return 1;
+    }
+    free(r->front.cells);
+    free(r->back.cells);
+    r->front = front;
+    r->back = back;
+    r->force_full = 1;
+    return 0;
+}
+
+void render_begin(renderer_t *r) { frame_clear(&r->back); }
+
+// Length of the UTF-8 sequence starting with byte c, 1 for invalid lead bytes
+int utf8_seq_len(unsigned char c) {
+    if (c < 0x80)
+        return 1;
+    if ((c & 0xE0) == 0xC0)
+        return 2;
+    if ((c & 0xF0) == 0xE0)
+        return 3;
+    if ((c & 0xF8) == 0xF0)
+        return 4;
+    return 1;
+}
+
+// Draws len bytes of s at (row, col), clipped to the frame. Returns the column after the text.
+int draw_text(renderer_t *r, int row, int col, int attr, const char *s, int len) {
+    frame_t *f = &r->back;
+    if (row < 0 || row >= f->rows) {
+        return col;
+    }
+    int i = 0;
+    while (i < len && s[i] != '\0') {
+        int n = utf8_seq_len((unsigned char)s[i]);
+        if (i + n > len) {
             break;
-        case EDIT_ENTRY_VIEW:
-            buf = edit_entry_buf;
-            buf_size = &edit_entry_buf_size;
-            buf_cursor = &edit_entry_buf_cursor;
-            buf_noop = 0;
-            break;
-        }
-
-        if (read(STDIN_FILENO, &input_handle_buf, 3) > 0) {
-            char ch = input_handle_buf[0];
-            switch (ch) {
-            case '\n': // ENTER
-                switch (current_view) {
-                case LIST_VIEW:
-                    entries[current_selection].completed = entries[current_selection].completed ? 0 : 1;
-                    update_entry(&entries[current_selection]);
-                    should_reload_entries = 1;
-                    break;
-                case NEW_ENTRY_VIEW:
-                    new_entry(buf);
-                    zero_buf(buf, buf_size, buf_cursor);
-                    current_view = LIST_VIEW;
-                    should_reload_entries = 1;
-                    break;
-                case EDIT_ENTRY_VIEW: {
-                    if ((*buf_size) == 0)
-                        break;
-
-                    int i = 0;
-                    for (; i < (*buf_size); i++) {
-                        entries[current_selection].description[i] = buf[i];
-                    }
-                    entries[current_selection].description[i] = '\0';
-
-                    update_entry(&entries[current_selection]);
-                    zero_buf(buf, buf_size, buf_cursor);
-                    should_reload_entries = 1;
-                    current_view = LIST_VIEW;
-                } break;
-                }
-                break;
-            case 'e':
-                switch (current_view) {
-                case LIST_VIEW:
-                    if (entries_in_view > 0) {
-                        int len = strlen(entries[current_selection].description);
-                        for (int i = 0; i < len; i++) {
-                            edit_entry_buf[i] = entries[current_selection].description[i];
-                        }
-
-                        edit_entry_buf_size = strlen(edit_entry_buf);
-                        edit_entry_buf_cursor = edit_entry_buf_size;
-                        current_view = EDIT_ENTRY_VIEW;
-                    }
-                    break;
-                case NEW_ENTRY_VIEW:
-                case EDIT_ENTRY_VIEW:
-                    goto treat_as_char;
-                }
-                break;
-            case 'd':
-                switch (current_view) {
-                case LIST_VIEW:
-                    delete_entry(&entries[current_selection]);
-                    should_reload_entries = 1;
-                    current_selection -= 1;
-                    if (current_selection < 0) {
-                        current_selection = 0;
-                    }
-                    break;
-                case NEW_ENTRY_VIEW:
-                case EDIT_ENTRY_VIEW:
-                    goto treat_as_char;
-                }
-                break;
-            case 'x':
-                switch (current_view) {
-                case LIST_VIEW:
-                    sqlite3_step(clear_completed_entries_stmt);
-                    sqlite3_reset(clear_completed_entries_stmt);
-                    should_reload_entries = 1;
-                    break;
-                case NEW_ENTRY_VIEW:
-                case EDIT_ENTRY_VIEW:
-                    goto treat_as_char;
-                }
-                break;
-            case 'n':
-                switch (current_view) {
-                case LIST_VIEW:
-                    current_view = NEW_ENTRY_VIEW;
-                    break;
-                case NEW_ENTRY_VIEW:
-                case EDIT_ENTRY_VIEW:
-                    goto treat_as_char;
-                }
-                break;
-            case 'q':
-                switch (current_view) {
-                case LIST_VIEW:
-                    return_defer(0);
-                    break;
-                case NEW_ENTRY_VIEW:
-                case EDIT_ENTRY_VIEW:
-                    goto treat_as_char;
-                }
-                break;
-            case 127: // DELETE
-                if (!buf_noop) {
-                    if ((*buf_size) > 0 && (*buf_cursor) > 0) {
-                        (*buf_cursor)--; // We want to delete the character to the left of the cursor
-                        for (int i = *buf_cursor; i < (*buf_size); i++) {
-                            buf[i] = buf[i + 1];
-                        }
-                        (*buf_size)--;
-                    }
-                }
-                break;
-            case 'k':
-                if (current_view == LIST_VIEW) {
-                    current_selection -= 1;
-                    if (current_selection < 0) {
-                        current_selection = MAX_SELECTION;
-                    }
-                } else {
-                    goto treat_as_char;
-                }
-                break;
-            case 'j':
-                if (current_view == LIST_VIEW) {
-                    current_selection += 1;
-                    if (current_selection > MAX_SELECTION) {
-                        current_selection = 0;
-                    }
-                } else {
-                    goto treat_as_char;
-                }
-                break;
-            case 27:
-                ch = input_handle_buf[1];
-                if (ch == '[') {
-                    ch = input_handle_buf[2];
-                    switch (ch) {
-                    case 'A': // UP ARROW
-                        if (current_view == LIST_VIEW) {
-                            current_selection -= 1;
-                            if (current_selection < 0) {
-                                current_selection = MAX_SELECTION;
-                            }
-                        }
-                        break;
-                    case 'B': // DOWN ARROW
-                        if (current_view == LIST_VIEW) {
-                            current_selection += 1;
-                            if (current_selection > MAX_SELECTION) {
-                                current_selection = 0;
-                            }
-                        }
-                        break;
-                    case 'C': // RIGHT ARROW
-                        if (!buf_noop) {
-                            (*buf_cursor)++;
-                            if ((*buf_cursor) > (*buf_size)) {
-                                (*buf_cursor) = (*buf_size);
-                            }
-                        }
-                        break;
-                    case 'D': // LEFT ARROW
-                        if (!buf_noop) {
-                            (*buf_cursor)--;
-                            if ((*buf_cursor) < 0) {
-                                (*buf_cursor) = 0;
-                            }
-                        }
-                        break;
-                    default:
-                        break;
-                    }
-                } else {
-                    if (input_handle_buf[1] == 0) {
-                        // ESCAPE
-                        switch (current_view) {
-                        case LIST_VIEW:
-                            return_defer(0);
-                            break;
-                        case NEW_ENTRY_VIEW:
-                            // Don't discard changes
-                            current_view = LIST_VIEW;
-                            break;
-                        case EDIT_ENTRY_VIEW:
-                            // Discard changes
-                            current_view = LIST_VIEW;
-                            zero_buf(buf, buf_size, buf_cursor);
-                            break;
-                        }
-                    }
-                }
-                break;
-            default:
-            treat_as_char:
-                switch (current_view) {
-                case LIST_VIEW:
-                    break;
-                case NEW_ENTRY_VIEW:
-                case EDIT_ENTRY_VIEW:
-                    if ((*buf_size) + 1 > MAX_STRING_LENGTH) {
-                        break;
-                    }
-                    (*buf_size)++;
-                    for (int i = (*buf_size); i > (*buf_cursor); i--) {
-                        buf[i] = buf[i - 1];
-                    }
-                    buf[(*buf_cursor)++] = ch;
-                    break;
-                }
-                break;
+        }
+        if (col >= f->cols) {
+            return col;
+        }
+        if (col >= 0) {
+            cell_t *cell = &f->cells[row * f->cols + col];
+            unsigned char c = (unsigned char)s[i];
+            if (n == 1 && (c < 0x20 || c == 0x7F)) {
+                // Never let control bytes reach the terminal
+                *cell = blank_cell;
+            } else {
+                memcpy(cell->ch, s + i, n);
+                cell->len = n;
             }
+            cell->attr = attr;
+        }
+        col++;
+        i += n;
+    }
+    return col;
+}
+
+int draw_fmt(renderer_t *r, int row, int col, int attr, const char *fmt, ...) {
+    char tmp[512];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, args);
+    va_end(args);
+    if (n < 0) {
+        return col;
+    }
+    if (n >= (int)sizeof(tmp)) {
+        n = sizeof(tmp) - 1;
+    }
+    return draw_text(r, row, col, attr, tmp, n);
+}
+
+void draw_cursor(renderer_t *r, int row, int col) {
+    r->back.cursor_row = row;
+    r->back.cursor_col = col;
+}
 
-            // cleanup input buffer
-            zero_array(input_handle_buf, 3);
+void out_append(renderer_t *r, const char *s, size_t n) {
+    if (r->out_len + n > r->out_cap) {
+        size_t cap = r->out_cap ? r->out_cap * 2 : 4096;
+        while (cap < r->out_len + n) {
+            cap *= 2;
         }
+        char *out = realloc(r->out, cap);
+        if (out == NULL) {
+            return;
+        }
+        r->out = out;
+        r->out_cap = cap;
     }
+    memcpy(r->out + r->out_len, s, n);
+    r->out_len += n;
+}
 
-defer:
-    restore_terminal_mode(&old_tio);
-    printf("Quitting program...\n");
-    sqlite3_finalize(get_entries_stmt);
-    sqlite3_finalize(insert_entry_stmt);
-    sqlite3_finalize(update_entry_stmt);
-    sqlite3_finalize(delete_entry_stmt);
-    sqlite3_finalize(clear_completed_entries_stmt);
+void out_fmt(renderer_t *r, const char *fmt, ...) {
+    char tmp[64];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, args);
+    va_end(args);
+    if (n > 0) {
+        out_append(r, tmp, n < (int)sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+    }
+}
+
+void out_attr(renderer_t *r, int attr) {
+    out_append(r, "\e[0", 3);
+    if (attr & ATTR_YELLOW)
+        out_append(r, ";33", 3);
+    if (attr & ATTR_STRIKETHROUGH)
+        out_append(r, ";9", 2);
+    out_append(r, "m", 1);
+}
+
+// Writes the output buffer to r->fd, counting the write() calls it takes
+int render_write(renderer_t *r) {
+    const char *s = r->out;
+    size_t n = r->out_len;
+    while (n > 0) {
+        ssize_t written = write(r->fd, s, n);
+        r->write_calls++;
+        if (written < 0) {
+            return 1;
+        }
+        s += written;
+        n -= written;
+    }
+    return 0;
+}
+
+// Sends the difference between the back and the front frame to the terminal and makes the back
+// frame the new front frame.
+int render_flush(renderer_t *r) {
+    frame_t *back = &r->back;
+    frame_t *front = &r->front;
+    r->out_len = 0;
+
+    int cursor_was_visible = front->cursor_row >= 0;
+    if (r->force_full) {
+        out_append(r, "\e[?25l\e[0m\e[H\e[2J", 17);
+        for (int i = 0; i < front->rows * front->cols; i++) {
+            front->cells[i] = blank_cell;
+        }
+        cursor_was_visible = 0;
+        r->force_full = 0;
+    } else if (cursor_was_visible) {
+        // Hide the cursor while cells are being rewritten, shown again below if needed
+        int cells_changed = 0;
+        for (int i = 0; i < back->rows * back->cols && !cells_changed; i++) {
+            cells_changed = !cell_eq(&back->cells[i], &front->cells[i]);
+        }
+        if (cells_changed) {
+            out_append(r, "\e[?25l", 6);
+            cursor_was_visible = 0;
+        }
+    }
+
+    int attr = -1;
+    for (int row = 0; row < back->rows; row++) {
+        cell_t *b = &back->cells[row * back->cols];
+        cell_t *f = &front->cells[row * front->cols];
+        int first = 0;
+        while (first < back->cols && cell_eq(&b[first], &f[first])) {
+            first++;
+        }
+        if (first == back->cols) {
+            continue;
+        }
+        int last = back->cols - 1;
+        while (last > first && cell_eq(&b[last], &f[last])) {
+            last--;
+        }
+        out_fmt(r, "\e[%d;%dH", row + 1, first + 1);
+        for (int col = first; col <= last; col++) {
+            if (b[col].attr != attr) {
+                attr = b[col].attr;
+                out_attr(r, attr);
+            }
+            out_append(r, b[col].ch, b[col].len);
+        }
+    }
+    if (attr != -1 && attr != ATTR_NONE) {
+        out_append(r, "\e[0m", 4);
+    }
+
+    if (back->cursor_row >= 0) {
+        if (!cursor_was_visible || back->cursor_row != front->cursor_row || back->cursor_col != front->cursor_col ||
+            attr != -1) {
+            out_fmt(r, "\e[%d;%dH", back->cursor_row + 1, back->cursor_col + 1);
+        }
+        if (!cursor_was_visible) {
+            out_append(r, "\e[?25h", 6);
+        }
+    } else if (cursor_was_visible) {
+        out_append(r, "\e[?25l", 6);
+    }
+
+    frame_t tmp = r->front;
+    r->front = r->back;
+    r->back = tmp;
+
+    r->frames++;
+    r->last_frame_bytes = r->out_len;
+    r->total_bytes += r->out_len;
+    if (r->out_len > r->max_frame_bytes) {
+        r->max_frame_bytes = r->out_len;
+    }
+    return render_write(r);
+}
+
+// Leaves the cursor visible on the line below the last drawn row
+void render_finish(renderer_t *r) {
+    frame_t *front = &r->front;
+    int last_row = -1;
+    for (int row = 0; row < front->rows; row++) {
+        for (int col = 0; col < front->cols; col++) {
+            if (!cell_eq(&front->cells[row * front->cols + col], &blank_cell)) {
+                last_row = row;
+                break;
+            }
+        }
+    }
+    r->out_len = 0;
+    if (last_row < 0) {
+        out_append(r, "\e[0m\e[H\e[?25h", 14);
+    } else {
+        out_fmt(r, "\e[0m\e[%d;1H\r\n\e[?25h", last_row + 1);
+    }
+    render_write(r);
+}
+
+#define return_defer(value) \
+    do {                    \
+        (result) = value;   \
+        goto defer;         \
+    } while (0)
+
+#define check_conn_err(conn, db_err, ctx)                                   \
+    do {                                                                    \
+        if ((db_err) != SQLITE_OK) {                                        \
+            fprintf(stderr, "[error] " ctx ": %s\n", sqlite3_errmsg(conn)); \
+            return_defer(1);                                                \
+        }                                                                   \
+    } while (0)
+
+#define check_db_err(db_err, ctx) check_conn_err(DB, db_err, ctx)
+
+// Arena
+//
+// Descriptions have no length limit, so entries point at text kept in an arena instead of carrying
+// it inline. Strings are bump-allocated from a chain of blocks and freed all at once, by whoever owns
+// the entries: the list window and the search results each have their own arena.
+
+#define ARENA_BLOCK_SIZE (16 * 1024)
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t used;
+    size_t cap;
+    char data[];
+} arena_block_t;
+
+typedef struct Arena {
+    arena_block_t *head; // block being allocated from, older blocks follow it
+    size_t used;         // bytes handed out since the last reset
+} arena_t;
+
+void *arena_alloc(arena_t *arena, size_t n) {
+    if (arena->head == NULL || arena->head->used + n > arena->head->cap) {
+        size_t cap = n > ARENA_BLOCK_SIZE ? n : ARENA_BLOCK_SIZE;
+        arena_block_t *block = malloc(sizeof(arena_block_t) + cap);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->head;
+        block->used = 0;
+        block->cap = cap;
+        arena->head = block;
+    }
+    void *p = arena->head->data + arena->head->used;
+    arena->head->used += n;
+    arena->used += n;
+    return p;
+}
+
+// Copies len bytes of s into the arena, NUL terminated
+char *arena_strndup(arena_t *arena, const char *s, size_t len) {
+    char *p = arena_alloc(arena, len + 1);
+    if (p != NULL) {
+        memcpy(p, s, len);
+        p[len] = '\0';
+    }
+    return p;
+}
+
+// Frees every string at once, keeping the newest block around for reuse
+void arena_reset(arena_t *arena) {
+    if (arena->head == NULL) {
+        return;
+    }
+    arena_block_t *block = arena->head->next;
+    while (block != NULL) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+    arena->used = 0;
+}
+
+void arena_free(arena_t *arena) {
+    arena_reset(arena);
+    free(arena->head);
+    arena->head = NULL;
+}
+
+#define LIST_PREFETCH_ROWS 16
+#define LIST_ARENA_COLLECT_BYTES (64 * 1024)
+
+typedef enum CurrentView {
+    LIST_VIEW,
+    NEW_ENTRY_VIEW,
+    EDIT_ENTRY_VIEW,
+    SEARCH_VIEW,
+    ACTIVITY_VIEW,
+    FILTER_VIEW
+} current_view_t;
+
+typedef struct Entry {
+    int id;
+    int completed;
+    int ignored;
+    int day;                  // the date the task is planned for, see day_of()
+    sqlite3_int64 updated_at; // 0 when the entry was never updated
+    double position;          // place in the day's list, see migrate_entries_position_v9_sql
+    const char *description;  // NUL terminated, owned by an arena or by the caller
+} entry_t;
+
+// Days
+//
+// Every task belongs to a day, stored as the number of days from 1970-01-01 to its local date.
+// SQL computes the same number with CAST(julianday(t, 'unixepoch', 'localtime') - 2440587.5 AS INTEGER).
+
+#define DAY_STRING_SIZE 11 // YYYY-MM-DD and the NUL
+
+int day_of(time_t t) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+    return (int)(timegm(&tm) / 86400);
+}
+
+int today(void) { return day_of(time(NULL)); }
+
+// Writes day as YYYY-MM-DD into out, which holds DAY_STRING_SIZE bytes
+void format_day(int day, char *out) {
+    time_t t = (time_t)day * 86400;
+    struct tm tm;
+    gmtime_r(&t, &tm);
+    strftime(out, DAY_STRING_SIZE, "%Y-%m-%d", &tm);
+}
+
+// Parses a YYYY-MM-DD date. Returns 0 on success.
+int parse_day(const char *s, int *day) {
+    struct tm tm = {0};
+    char rest;
+    if (sscanf(s, "%d-%d-%d%c", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &rest) != 3 || tm.tm_mon < 1 ||
+        tm.tm_mon > 12 || tm.tm_mday < 1 || tm.tm_mday > 31) {
+        return 1;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    int year = tm.tm_year, mon = tm.tm_mon, mday = tm.tm_mday;
+    time_t t = timegm(&tm);
+    // timegm normalizes out of range days, 2024-02-31 would come back as 2024-03-02
+    if (tm.tm_year != year || tm.tm_mon != mon || tm.tm_mday != mday) {
+        return 1;
+    }
+    (*day) = (int)(t / 86400);
+    return 0;
+}
+
+// Monday of the week day is in
+int week_of(int day) { return day - ((day + 3) % 7 + 7) % 7; }
+
+#define ACTIVITY_DAYS 7
+#define ACTIVITY_WEEKS 4
+
+typedef struct DayCounts {
+    int day; // the first day of a week for week counts
+    int created;
+    int completed;
+    int cleared;
+} day_counts_t;
+
+// What the activity view shows, see load_activity()
+typedef struct Activity {
+    int end;                            // last day shown
+    day_counts_t days[ACTIVITY_DAYS];   // the days up to end, oldest first
+    day_counts_t weeks[ACTIVITY_WEEKS]; // the weeks up to the one of end, oldest first
+    int streak;                         // days in a row with a completed task, up to today
+    int longest_streak;
+} activity_t;
+
+// Tags
+//
+// Tags and priorities are written in the description, so every way a task is written, synced or
+// imported carries them: a word `#name` tags the task with name, and a word `!`, `!!` or `!!!` gives it
+// priority 1 to 3. Triggers keep them in the tags, entry_tags and entries.priority columns the filter
+// queries search, see migrate_tags_v11_sql; the functions here apply the same rules to entries in
+// memory. Tag names compare without regard to ASCII case, like the NOCASE collation of tags.name.
+
+#define PRIORITY_MAX 3
+#define FILTER_MAX_TAGS 4
+#define TAG_NAME_SIZE 32 // longer tags are not offered by the filter view
+
+typedef struct Tag {
+    int id;
+    char name[TAG_NAME_SIZE];
+} tag_t;
+
+// The filter view narrows the list down to the entries with at least priority and every tag in tags
+typedef struct Filter {
+    int priority;
+    tag_t tags[FILTER_MAX_TAGS];
+    int tags_sz;
+} filter_t;
+
+int is_word_space(char c) { return c == ' ' || c == '\t' || c == '\n'; }
+
+// Finds the next word of s from *pos on, see Tags. Returns its length, 0 at the end of s.
+int next_word(const char *s, int *pos, int *start) {
+    int i = *pos;
+    while (s[i] != '\0' && is_word_space(s[i])) {
+        i++;
+    }
+    *start = i;
+    while (s[i] != '\0' && !is_word_space(s[i])) {
+        i++;
+    }
+    *pos = i;
+    return i - *start;
+}
+
+// Priority a word gives, 0 for anything but `!`, `!!` and `!!!`
+int word_priority(const char *word, int len) {
+    if (len > PRIORITY_MAX) {
+        return 0;
+    }
+    for (int i = 0; i < len; i++) {
+        if (word[i] != '!') {
+            return 0;
+        }
+    }
+    return len;
+}
+
+// Highest priority given by a word of description
+int description_priority(const char *description) {
+    int pos = 0, start, len, priority = 0;
+    while ((len = next_word(description, &pos, &start)) > 0) {
+        int p = word_priority(description + start, len);
+        priority = p > priority ? p : priority;
+    }
+    return priority;
+}
+
+int description_has_tag(const char *description, const char *name) {
+    int name_len = strlen(name);
+    int pos = 0, start, len;
+    while ((len = next_word(description, &pos, &start)) > 0) {
+        if (len == name_len + 1 && description[start] == '#' &&
+            strncasecmp(description + start + 1, name, name_len) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Writes description into out with its priority words replaced by one for priority, put first, or
+// taken out for priority 0. out holds strlen(description) + PRIORITY_MAX + 2 bytes.
+void description_set_priority(const char *description, int priority, char *out) {
+    int n = 0;
+    for (int i = 0; i < priority; i++) {
+        out[n++] = '!';
+    }
+    int pos = 0, start, len;
+    while ((len = next_word(description, &pos, &start)) > 0) {
+        if (word_priority(description + start, len) > 0) {
+            continue;
+        }
+        if (n > 0) {
+            out[n++] = ' ';
+        }
+        memcpy(out + n, description + start, len);
+        n += len;
+    }
+    out[n] = '\0';
+}
+
+int filter_active(const filter_t *filter) { return filter != NULL && (filter->priority > 0 || filter->tags_sz > 0); }
+
+int filter_matches(const filter_t *filter, const entry_t *entry) {
+    if (!filter_active(filter)) {
+        return 1;
+    }
+    if (filter->priority > 0 && description_priority(entry->description) < filter->priority) {
+        return 0;
+    }
+    for (int i = 0; i < filter->tags_sz; i++) {
+        if (!description_has_tag(entry->description, filter->tags[i].name)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Adds tag to the filter, or takes it out if it is in already. Returns 1 when the filter is full.
+int filter_toggle_tag(filter_t *filter, const tag_t *tag) {
+    for (int i = 0; i < filter->tags_sz; i++) {
+        if (filter->tags[i].id == tag->id) {
+            filter->tags[i] = filter->tags[--filter->tags_sz];
+            return 0;
+        }
+    }
+    if (filter->tags_sz == FILTER_MAX_TAGS) {
+        return 1;
+    }
+    filter->tags[filter->tags_sz++] = *tag;
+    return 0;
+}
+
+int filter_has_tag(const filter_t *filter, int id) {
+    for (int i = 0; i < filter->tags_sz; i++) {
+        if (filter->tags[i].id == id) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int filter_eq(const filter_t *a, const filter_t *b) {
+    if (a->priority != b->priority || a->tags_sz != b->tags_sz) {
+        return 0;
+    }
+    for (int i = 0; i < a->tags_sz; i++) {
+        if (!filter_has_tag(b, a->tags[i].id)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+#define FILTER_STRING_SIZE (PRIORITY_MAX + FILTER_MAX_TAGS * (TAG_NAME_SIZE + 1) + 1)
+
+// Writes the filter the way it is written in descriptions, like `!! #work #home`, into out, which holds
+// FILTER_STRING_SIZE bytes
+void format_filter(const filter_t *filter, char *out) {
+    int n = 0;
+    for (int i = 0; i < filter->priority; i++) {
+        out[n++] = '!';
+    }
+    for (int i = 0; i < filter->tags_sz; i++) {
+        n += sprintf(out + n, "%s#%s", n > 0 ? " " : "", filter->tags[i].name);
+    }
+    out[n] = '\0';
+}
+
+#define create_table_entries_sql          \
+    "CREATE TABLE IF NOT EXISTS entries(" \
+    "id INTEGER PRIMARY KEY, "            \
+    "description TEXT NOT NULL, "         \
+    "completed INTEGER DEFAULT(0), "      \
+    "ignored INTEGER DEFAULT(0)"          \
+    ");"
+
+#define migrate_table_entries_v1_sql "ALTER TABLE entries ADD COLUMN updated_at INTEGER;"
+
+// Partial covering index in list order: every list query becomes an index range search that never
+// touches the table nor sorts, and cleared entries stay out of it entirely.
+#define migrate_list_index_v2_sql                                          \
+    "CREATE INDEX IF NOT EXISTS entries_list_idx "                         \
+    "ON entries(completed, updated_at DESC, id DESC, description) "        \
+    "WHERE ignored = 0;"
+
+// Full-text index over descriptions for the search view. It is an external-content table, so the text
+// is stored once, in entries, and triggers keep the index in sync with every insert, update and delete.
+#define migrate_entries_fts_v3_sql                                                                       \
+    "CREATE VIRTUAL TABLE entries_fts USING fts5(description, content='entries', content_rowid='id');"  \
+    "CREATE TRIGGER entries_fts_insert AFTER INSERT ON entries BEGIN "                                   \
+    "INSERT INTO entries_fts(rowid, description) VALUES (new.id, new.description); "                     \
+    "END;"                                                                                               \
+    "CREATE TRIGGER entries_fts_delete AFTER DELETE ON entries BEGIN "                                   \
+    "INSERT INTO entries_fts(entries_fts, rowid, description) VALUES ('delete', old.id, old.description); " \
+    "END;"                                                                                               \
+    "CREATE TRIGGER entries_fts_update AFTER UPDATE OF description ON entries BEGIN "                    \
+    "INSERT INTO entries_fts(entries_fts, rowid, description) VALUES ('delete', old.id, old.description); " \
+    "INSERT INTO entries_fts(rowid, description) VALUES (new.id, new.description); "                     \
+    "END;"                                                                                               \
+    "INSERT INTO entries_fts(entries_fts) VALUES ('rebuild');"
+
+// Cleared entries waiting to be archived, see archive_entries()
+#define migrate_cleared_index_v4_sql "CREATE INDEX IF NOT EXISTS entries_cleared_idx ON entries(id) WHERE ignored = 1;"
+
+// Next free entry id, shared by every process that opens the database, see reserve_entry_ids_sql
+#define migrate_entry_ids_v5_sql                       \
+    "CREATE TABLE entry_ids(next INTEGER NOT NULL);" \
+    "INSERT INTO entry_ids SELECT ifnull(max(id), 0) + 1 FROM entries;"
+
+// Tasks are planned per day. Existing tasks go to today, except completed ones, which stay on the day
+// they were completed. The list index gains day as its first column, so a day's list is one
+// contiguous range of it whatever the length of the history, and a second partial index holds only
+// unfinished tasks, so rolling them over doesn't walk the finished ones of every past day.
+#define migrate_entries_day_v6_sql                                                                        \
+    "ALTER TABLE entries ADD COLUMN day INTEGER NOT NULL DEFAULT 0;"                                      \
+    "UPDATE entries SET day = CAST(julianday("                                                            \
+    "CASE WHEN completed = 1 AND updated_at IS NOT NULL THEN updated_at ELSE strftime('%s', 'now') END, " \
+    "'unixepoch', 'localtime') - 2440587.5 AS INTEGER);"                                                  \
+    "DROP INDEX IF EXISTS entries_list_idx;"                                                              \
+    "CREATE INDEX entries_list_idx ON entries(day, completed, updated_at DESC, id DESC, description) "    \
+    "WHERE ignored = 0;"                                                                                  \
+    "CREATE INDEX entries_open_idx ON entries(day) WHERE completed = 0 AND ignored = 0;"
+
+// A cleared entry's ignored now holds the time it was cleared at instead of 1, so the entries of one
+// clear can be told apart and restored by undo. Entries cleared by older versions keep 1.
+#define migrate_cleared_at_v7_sql               \
+    "DROP INDEX IF EXISTS entries_cleared_idx;" \
+    "CREATE INDEX entries_cleared_idx ON entries(ignored) WHERE ignored != 0;"
+
+// Change log for syncing databases, see the Sync section. Every database gets a random site id, every
+// entry a uid that stays the same in every database it is synced to, and triggers append every insert,
+// update and delete of entries to changes, stamped with the site's logical clock. Existing entries are
+// logged as inserted at clock 1, so the first export carries the whole list.
+#define migrate_change_log_v8_sql                                                                           \
+    "CREATE TABLE sync_state(site TEXT NOT NULL, clock INTEGER NOT NULL, paused INTEGER NOT NULL);"         \
+    "INSERT INTO sync_state VALUES (lower(hex(randomblob(8))), 1, 0);"                                      \
+    "ALTER TABLE entries ADD COLUMN uid TEXT;"                                                              \
+    "UPDATE entries SET uid = (SELECT site FROM sync_state) || '-' || id;"                                  \
+    "CREATE UNIQUE INDEX entries_uid_idx ON entries(uid);"                                                  \
+    "CREATE TABLE changes("                                                                                 \
+    "seq INTEGER PRIMARY KEY, uid TEXT NOT NULL, clock INTEGER NOT NULL, site TEXT NOT NULL, "              \
+    "deleted INTEGER NOT NULL, description TEXT, completed INTEGER, ignored INTEGER, day INTEGER, "         \
+    "updated_at INTEGER);"                                                                                  \
+    "CREATE UNIQUE INDEX changes_uid_idx ON changes(uid, clock, site);"                                     \
+    "INSERT INTO changes (uid, clock, site, deleted, description, completed, ignored, day, updated_at) "    \
+    "SELECT uid, 1, (SELECT site FROM sync_state), 0, description, completed, ignored, day, updated_at "    \
+    "FROM entries ORDER BY id;"                                                                             \
+    "CREATE TRIGGER entries_uid AFTER INSERT ON entries WHEN new.uid IS NULL BEGIN "                        \
+    "UPDATE entries SET uid = (SELECT site FROM sync_state) || '-' || new.id WHERE id = new.id; "           \
+    "END;"                                                                                                  \
+    "CREATE TRIGGER entries_log_insert AFTER INSERT ON entries "                                            \
+    "WHEN (SELECT paused FROM sync_state) = 0 BEGIN "                                                       \
+    "UPDATE sync_state SET clock = clock + 1; "                                                             \
+    "INSERT INTO changes (uid, clock, site, deleted, description, completed, ignored, day, updated_at) "    \
+    "SELECT ifnull(new.uid, site || '-' || new.id), clock, site, 0, "                                       \
+    "new.description, new.completed, new.ignored, new.day, new.updated_at FROM sync_state; "                \
+    "END;"                                                                                                  \
+    "CREATE TRIGGER entries_log_update AFTER UPDATE OF description, completed, ignored, day, updated_at "   \
+    "ON entries WHEN (SELECT paused FROM sync_state) = 0 AND (old.description IS NOT new.description "      \
+    "OR old.completed IS NOT new.completed OR old.ignored IS NOT new.ignored OR old.day IS NOT new.day "    \
+    "OR old.updated_at IS NOT new.updated_at) BEGIN "                                                       \
+    "UPDATE sync_state SET clock = clock + 1; "                                                             \
+    "INSERT INTO changes (uid, clock, site, deleted, description, completed, ignored, day, updated_at) "    \
+    "SELECT new.uid, clock, site, 0, new.description, new.completed, new.ignored, new.day, new.updated_at " \
+    "FROM sync_state; "                                                                                     \
+    "END;"                                                                                                  \
+    "CREATE TRIGGER entries_log_delete AFTER DELETE ON entries "                                            \
+    "WHEN (SELECT paused FROM sync_state) = 0 BEGIN "                                                       \
+    "UPDATE sync_state SET clock = clock + 1; "                                                             \
+    "INSERT INTO changes (uid, clock, site, deleted) SELECT old.uid, clock, site, 1 FROM sync_state; "      \
+    "END;"
+
+// Tasks are put in order by hand instead of by completion and update time. A day's list is ordered by
+// position, a fractional key: a task moved between two others takes the midpoint of their positions,
+// so a move updates a single row. Positions start POSITION_STEP apart, in the order the list had so
+// far. The change log carries positions too, so syncing keeps the order.
+#define migrate_entries_position_v9_sql                                                                    \
+    "ALTER TABLE entries ADD COLUMN position REAL NOT NULL DEFAULT 0;"                                     \
+    "UPDATE entries SET position = r.n * 1024 FROM (SELECT id, row_number() OVER ("                        \
+    "PARTITION BY day ORDER BY completed, updated_at DESC, id DESC) AS n FROM entries) AS r "              \
+    "WHERE entries.id = r.id;"                                                                             \
+    "DROP INDEX entries_list_idx;"                                                                         \
+    "CREATE INDEX entries_list_idx ON entries(day, position, id, completed, updated_at, description) "     \
+    "WHERE ignored = 0;"                                                                                   \
+    "ALTER TABLE changes ADD COLUMN position REAL;"                                                        \
+    "UPDATE changes SET position = (SELECT position FROM entries WHERE entries.uid = changes.uid) "        \
+    "WHERE deleted = 0;"                                                                                   \
+    "DROP TRIGGER entries_log_insert;"                                                                     \
+    "DROP TRIGGER entries_log_update;"                                                                     \
+    "CREATE TRIGGER entries_log_insert AFTER INSERT ON entries "                                           \
+    "WHEN (SELECT paused FROM sync_state) = 0 BEGIN "                                                      \
+    "UPDATE sync_state SET clock = clock + 1; "                                                            \
+    "INSERT INTO changes "                                                                                 \
+    "(uid, clock, site, deleted, description, completed, ignored, day, updated_at, position) "             \
+    "SELECT ifnull(new.uid, site || '-' || new.id), clock, site, 0, "                                      \
+    "new.description, new.completed, new.ignored, new.day, new.updated_at, new.position FROM sync_state; " \
+    "END;"                                                                                                 \
+    "CREATE TRIGGER entries_log_update "                                                                   \
+    "AFTER UPDATE OF description, completed, ignored, day, updated_at, position ON entries "               \
+    "WHEN (SELECT paused FROM sync_state) = 0 AND (old.description IS NOT new.description "                \
+    "OR old.completed IS NOT new.completed OR old.ignored IS NOT new.ignored OR old.day IS NOT new.day "   \
+    "OR old.updated_at IS NOT new.updated_at OR old.position IS NOT new.position) BEGIN "                  \
+    "UPDATE sync_state SET clock = clock + 1; "                                                            \
+    "INSERT INTO changes "                                                                                 \
+    "(uid, clock, site, deleted, description, completed, ignored, day, updated_at, position) "             \
+    "SELECT new.uid, clock, site, 0, "                                                                     \
+    "new.description, new.completed, new.ignored, new.day, new.updated_at, new.position FROM sync_state; " \
+    "END;"
+
+// Day an entry counts as completed on, NULL while it isn't: the day of its last update, or its own day
+// when it was completed without a time, e.g. by an import
+#define stats_completed_day_sql(row)                                                                \
+    "(CASE WHEN " row ".completed = 1 THEN ifnull(CAST(julianday(" row ".updated_at, 'unixepoch', " \
+    "'localtime') - 2440587.5 AS INTEGER), " row ".day) END)"
+
+// Day an entry counts as cleared on, NULL while it isn't. Entries cleared by older versions have no
+// time, see migrate_cleared_at_v7_sql, and count on the day they were completed.
+#define stats_cleared_day_sql(row)                                                                     \
+    "(CASE WHEN " row ".ignored > 1 THEN CAST(julianday(" row ".ignored, 'unixepoch', 'localtime') - " \
+    "2440587.5 AS INTEGER) WHEN " row ".ignored != 0 THEN ifnull(CAST(julianday(" row ".updated_at, "  \
+    "'unixepoch', 'localtime') - 2440587.5 AS INTEGER), " row ".day) END)"
+
+#define stats_today_sql "CAST(julianday('now', 'localtime') - 2440587.5 AS INTEGER)"
+
+// Sets the streak of new.day and of the days in a row after it with a completed task: the streak of
+// the day before plus one while there are completed tasks, 0 on a day without any
+#define daily_stats_streak_sql                                                                   \
+    "UPDATE daily_stats SET streak = r.streak FROM (WITH RECURSIVE run(day, streak) AS ("        \
+    "SELECT new.day, CASE WHEN new.completed > 0 "                                               \
+    "THEN ifnull((SELECT streak FROM daily_stats WHERE day = new.day - 1), 0) + 1 ELSE 0 END "   \
+    "UNION ALL SELECT s.day, run.streak + 1 FROM run JOIN daily_stats s ON s.day = run.day + 1 " \
+    "AND s.completed > 0) SELECT day, streak FROM run) AS r "                                    \
+    "WHERE daily_stats.day = r.day AND daily_stats.streak != r.streak; "
+
+// Counters behind the activity view, see load_activity(). daily_stats holds, for every day, how many
+// tasks were created, completed and cleared on it, and the streak of days in a row up to it with a
+// completed task. Triggers on entries keep the counts up to date and triggers on daily_stats the
+// streaks, so the view reads a few dozen rows however long the history is. Entries remember the day
+// they were created on, so deleting one takes it back out of the counts; cleared entries are only
+// deleted by archiving, which keeps them in. Existing entries count as created on their own day.
+#define migrate_daily_stats_v10_sql                                                                             \
+    "CREATE TABLE daily_stats(day INTEGER PRIMARY KEY, created INTEGER NOT NULL DEFAULT 0, "                    \
+    "completed INTEGER NOT NULL DEFAULT 0, cleared INTEGER NOT NULL DEFAULT 0, "                                \
+    "streak INTEGER NOT NULL DEFAULT 0);"                                                                       \
+    "CREATE INDEX daily_stats_streak_idx ON daily_stats(streak);"                                               \
+    "ALTER TABLE entries ADD COLUMN created_day INTEGER;"                                                       \
+    "UPDATE entries SET created_day = day;"                                                                     \
+    "INSERT INTO daily_stats (day, created, completed, cleared) "                                               \
+    "SELECT day, sum(created), sum(completed), sum(cleared) FROM ("                                             \
+    "SELECT created_day AS day, 1 AS created, 0 AS completed, 0 AS cleared FROM entries "                       \
+    "UNION ALL SELECT " stats_completed_day_sql("entries") ", 0, 1, 0 FROM entries WHERE completed = 1 "        \
+    "UNION ALL SELECT " stats_cleared_day_sql("entries") ", 0, 0, 1 FROM entries WHERE ignored != 0) "          \
+    "GROUP BY day;"                                                                                             \
+    "UPDATE daily_stats SET streak = r.streak FROM (SELECT day, row_number() OVER ("                            \
+    "PARTITION BY day - n ORDER BY day) AS streak FROM ("                                                       \
+    "SELECT day, row_number() OVER (ORDER BY day) AS n FROM daily_stats WHERE completed > 0)) AS r "            \
+    "WHERE daily_stats.day = r.day;"                                                                            \
+    "CREATE TRIGGER daily_stats_streak_insert AFTER INSERT ON daily_stats WHEN new.completed > 0 BEGIN "        \
+    daily_stats_streak_sql                                                                                      \
+    "END;"                                                                                                      \
+    "CREATE TRIGGER daily_stats_streak_update AFTER UPDATE OF completed ON daily_stats "                        \
+    "WHEN (old.completed > 0) != (new.completed > 0) BEGIN "                                                    \
+    daily_stats_streak_sql                                                                                      \
+    "END;"                                                                                                      \
+    "CREATE TRIGGER entries_stats_insert AFTER INSERT ON entries BEGIN "                                        \
+    "UPDATE entries SET created_day = " stats_today_sql " WHERE id = new.id AND new.created_day IS NULL; "      \
+    "INSERT INTO daily_stats (day, created) VALUES (ifnull(new.created_day, " stats_today_sql "), 1) "          \
+    "ON CONFLICT(day) DO UPDATE SET created = created + 1; "                                                    \
+    "INSERT INTO daily_stats (day, completed) SELECT " stats_completed_day_sql("new") ", 1 "                    \
+    "WHERE new.completed = 1 ON CONFLICT(day) DO UPDATE SET completed = completed + 1; "                        \
+    "INSERT INTO daily_stats (day, cleared) SELECT " stats_cleared_day_sql("new") ", 1 "                        \
+    "WHERE new.ignored != 0 ON CONFLICT(day) DO UPDATE SET cleared = cleared + 1; "                             \
+    "END;"                                                                                                      \
+    "CREATE TRIGGER entries_stats_update AFTER UPDATE OF completed, ignored, day, updated_at ON entries "       \
+    "WHEN " stats_completed_day_sql("old") " IS NOT " stats_completed_day_sql("new") " "                        \
+    "OR " stats_cleared_day_sql("old") " IS NOT " stats_cleared_day_sql("new") " BEGIN "                        \
+    "UPDATE daily_stats SET completed = completed - 1 WHERE day = " stats_completed_day_sql("old") " "          \
+    "AND " stats_completed_day_sql("old") " IS NOT " stats_completed_day_sql("new") "; "                        \
+    "INSERT INTO daily_stats (day, completed) SELECT " stats_completed_day_sql("new") ", 1 "                    \
+    "WHERE new.completed = 1 AND " stats_completed_day_sql("old") " IS NOT " stats_completed_day_sql("new") " " \
+    "ON CONFLICT(day) DO UPDATE SET completed = completed + 1; "                                                \
+    "UPDATE daily_stats SET cleared = cleared - 1 WHERE day = " stats_cleared_day_sql("old") " "                \
+    "AND " stats_cleared_day_sql("old") " IS NOT " stats_cleared_day_sql("new") "; "                            \
+    "INSERT INTO daily_stats (day, cleared) SELECT " stats_cleared_day_sql("new") ", 1 "                        \
+    "WHERE new.ignored != 0 AND " stats_cleared_day_sql("old") " IS NOT " stats_cleared_day_sql("new") " "      \
+    "ON CONFLICT(day) DO UPDATE SET cleared = cleared + 1; "                                                    \
+    "END;"                                                                                                      \
+    "CREATE TRIGGER entries_stats_delete AFTER DELETE ON entries WHEN old.ignored = 0 BEGIN "                   \
+    "UPDATE daily_stats SET created = created - 1 WHERE day = old.created_day; "                                \
+    "UPDATE daily_stats SET completed = completed - 1 WHERE day = " stats_completed_day_sql("old") "; "         \
+    "END;"
+
+// Words of the descriptions selected by select, which returns (id, description): one (id, word) row per
+// word, see the Tags section
+#define entry_words_sql(select)                                                                       \
+    "(WITH RECURSIVE s(id, description) AS (" select "), w(id, word, rest) AS ("                      \
+    "SELECT id, '', replace(replace(description, char(10), ' '), char(9), ' ') || ' ' FROM s "        \
+    "UNION ALL SELECT id, substr(rest, 1, instr(rest, ' ') - 1), substr(rest, instr(rest, ' ') + 1) " \
+    "FROM w WHERE rest != '') SELECT id, word FROM w WHERE word != '')"
+
+#define word_priority_sql "max(CASE word WHEN '!' THEN 1 WHEN '!!' THEN 2 WHEN '!!!' THEN 3 ELSE 0 END)"
+
+// Adds the tags of the descriptions selected by select to tags and entry_tags, as of migrate_tags_v11_sql
+#define insert_entry_tags_v11_sql(select)                                                                 \
+    "INSERT OR IGNORE INTO tags (name) SELECT substr(word, 2) FROM " entry_words_sql(select) " "          \
+    "WHERE word LIKE '#_%'; "                                                                             \
+    "INSERT OR IGNORE INTO entry_tags (tag_id, entry_id) SELECT t.id, w.id FROM " entry_words_sql(select) \
+    " AS w JOIN tags t ON t.name = substr(w.word, 2) WHERE w.word LIKE '#_%'; "
+
+// Adds the tags of the descriptions selected by select to tags and entry_tags, with the list columns
+// entry_tags copies from the entry since migrate_tag_list_v12_sql
+#define insert_entry_tags_sql(select)                                                                        \
+    "INSERT OR IGNORE INTO tags (name) SELECT substr(word, 2) FROM " entry_words_sql(select) " "             \
+    "WHERE word LIKE '#_%'; "                                                                                \
+    "INSERT OR IGNORE INTO entry_tags (tag_id, entry_id, day, position, ignored) "                           \
+    "SELECT t.id, w.id, e.day, e.position, e.ignored FROM " entry_words_sql(select) " AS w "                 \
+    "JOIN tags t ON t.name = substr(w.word, 2) JOIN entries e ON e.id = w.id WHERE w.word LIKE '#_%'; "
+
+// Triggers that parse the words of a description whenever it is written, adding its tags with insert_tags
+#define entries_tags_triggers_sql(insert_tags)                                                    \
+    "CREATE TRIGGER entries_tags_insert AFTER INSERT ON entries BEGIN "                           \
+    insert_tags("SELECT new.id, new.description WHERE instr(new.description, '#') > 0")           \
+    "UPDATE entries SET priority = (SELECT " word_priority_sql " FROM "                           \
+    entry_words_sql("SELECT new.id, new.description") ") "                                        \
+    "WHERE id = new.id AND instr(new.description, '!') > 0; "                                     \
+    "END;"                                                                                        \
+    "CREATE TRIGGER entries_tags_update AFTER UPDATE OF description ON entries "                  \
+    "WHEN old.description IS NOT new.description BEGIN "                                          \
+    "DELETE FROM entry_tags WHERE entry_id = new.id; "                                            \
+    insert_tags("SELECT new.id, new.description WHERE instr(new.description, '#') > 0")           \
+    "UPDATE entries SET priority = ifnull((SELECT " word_priority_sql " FROM "                    \
+    entry_words_sql("SELECT new.id, new.description") "), 0) WHERE id = new.id; "                 \
+    "END;"
+
+// Tags and priorities, see the Tags section. tags holds every tag name once, entry_tags which entries
+// have it, keyed by tag first so the filter checks an entry for a tag with one primary key search.
+// Triggers parse the words of a description whenever it is written. The list index gains priority,
+// so filtering on it doesn't leave the index either.
+#define migrate_tags_v11_sql                                                                            \
+    "CREATE TABLE tags(id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE COLLATE NOCASE);"              \
+    "CREATE TABLE entry_tags(tag_id INTEGER NOT NULL, entry_id INTEGER NOT NULL, "                      \
+    "PRIMARY KEY (tag_id, entry_id)) WITHOUT ROWID;"                                                    \
+    "CREATE INDEX entry_tags_entry_idx ON entry_tags(entry_id);"                                        \
+    "ALTER TABLE entries ADD COLUMN priority INTEGER NOT NULL DEFAULT 0;"                               \
+    insert_entry_tags_v11_sql("SELECT id, description FROM entries WHERE instr(description, '#') > 0")  \
+    "UPDATE entries SET priority = p.priority FROM (SELECT id, " word_priority_sql " AS priority FROM " \
+    entry_words_sql("SELECT id, description FROM entries WHERE instr(description, '!') > 0") " "        \
+    "GROUP BY id) AS p WHERE entries.id = p.id AND p.priority > 0;"                                     \
+    "DROP INDEX entries_list_idx;"                                                                      \
+    "CREATE INDEX entries_list_idx "                                                                    \
+    "ON entries(day, position, id, completed, updated_at, priority, description) WHERE ignored = 0;"    \
+    entries_tags_triggers_sql(insert_entry_tags_v11_sql)                                                \
+    "CREATE TRIGGER entries_tags_delete AFTER DELETE ON entries BEGIN "                                 \
+    "DELETE FROM entry_tags WHERE entry_id = old.id; "                                                  \
+    "END;"
+
+// entry_tags copies the day, position and cleared state of its entry, so the entries of a day with a tag
+// are one range of entry_tags_list_idx in list order. The triggers adding tags are replaced by ones that
+// fill the copies in, and another keeps them up to date as entries are moved, rolled over or cleared.
+#define migrate_tag_list_v12_sql                                                                             \
+    "ALTER TABLE entry_tags ADD COLUMN day INTEGER NOT NULL DEFAULT 0;"                                      \
+    "ALTER TABLE entry_tags ADD COLUMN position REAL NOT NULL DEFAULT 0;"                                    \
+    "ALTER TABLE entry_tags ADD COLUMN ignored INTEGER DEFAULT 0;"                                           \
+    "UPDATE entry_tags SET day = e.day, position = e.position, ignored = e.ignored "                         \
+    "FROM entries e WHERE e.id = entry_tags.entry_id;"                                                       \
+    "CREATE INDEX entry_tags_list_idx ON entry_tags(tag_id, day, position, entry_id) WHERE ignored = 0;"     \
+    "DROP TRIGGER entries_tags_insert;"                                                                      \
+    "DROP TRIGGER entries_tags_update;"                                                                      \
+    entries_tags_triggers_sql(insert_entry_tags_sql)                                                         \
+    "CREATE TRIGGER entries_tags_list AFTER UPDATE OF day, position, ignored ON entries "                    \
+    "WHEN old.day IS NOT new.day OR old.position IS NOT new.position OR old.ignored IS NOT new.ignored BEGIN " \
+    "UPDATE entry_tags SET day = new.day, position = new.position, ignored = new.ignored "                   \
+    "WHERE entry_id = new.id; "                                                                              \
+    "END;"
+
+// A day's list is ordered by (position, id) and paged with keyset pagination: every page is one range
+// search of entries_list_idx, see load_entries(). Equal positions, given at once by two instances,
+// keep the older entry first.
+#define get_entries_after_sql                                               \
+    "SELECT id, description, completed, updated_at, position FROM entries " \
+    "WHERE ignored = 0 AND day = ? AND (position, id) > (?, ?) ORDER BY position, id LIMIT ?;"
+
+#define get_entries_before_sql                                              \
+    "SELECT id, description, completed, updated_at, position FROM entries " \
+    "WHERE ignored = 0 AND day = ? AND (position, id) < (?, ?) ORDER BY position DESC, id DESC LIMIT ?;"
+
+// A filter on priority alone walks the same range of entries_list_idx, checking each entry's priority in
+// the index. ?5 is the lowest priority shown.
+#define get_filtered_entries_after_sql                                                           \
+    "SELECT id, description, completed, updated_at, position FROM entries "                      \
+    "WHERE ignored = 0 AND day = ?1 AND (position, id) > (?2, ?3) AND priority >= ?5 "           \
+    "ORDER BY position, id LIMIT ?4;"
+
+#define get_filtered_entries_before_sql                                                          \
+    "SELECT id, description, completed, updated_at, position FROM entries "                      \
+    "WHERE ignored = 0 AND day = ?1 AND (position, id) < (?2, ?3) AND priority >= ?5 "           \
+    "ORDER BY position DESC, id DESC LIMIT ?4;"
+
+// A filter with tags reads the entries of the day with its first tag, ?6, from entry_tags_list_idx in list
+// order, so a page costs the entries with that tag it passes over, not the whole day. Each is checked for
+// priority ?5 and for the other tags ?7 to ?9, NULL past the last one, see FILTER_MAX_TAGS.
+#define filter_tags_sql                                                                                   \
+    "AND e.priority >= ?5 "                                                                               \
+    "AND (?7 IS NULL OR EXISTS (SELECT 1 FROM entry_tags WHERE tag_id = ?7 AND entry_id = t.entry_id)) " \
+    "AND (?8 IS NULL OR EXISTS (SELECT 1 FROM entry_tags WHERE tag_id = ?8 AND entry_id = t.entry_id)) " \
+    "AND (?9 IS NULL OR EXISTS (SELECT 1 FROM entry_tags WHERE tag_id = ?9 AND entry_id = t.entry_id)) "
+
+#define get_tagged_entries_after_sql                                                             \
+    "SELECT e.id, e.description, e.completed, e.updated_at, e.position "                         \
+    "FROM entry_tags t CROSS JOIN entries e ON e.id = t.entry_id "                               \
+    "WHERE t.tag_id = ?6 AND t.ignored = 0 AND t.day = ?1 AND (t.position, t.entry_id) > (?2, ?3) " \
+    filter_tags_sql "ORDER BY t.position, t.entry_id LIMIT ?4;"
+
+#define get_tagged_entries_before_sql                                                            \
+    "SELECT e.id, e.description, e.completed, e.updated_at, e.position "                         \
+    "FROM entry_tags t CROSS JOIN entries e ON e.id = t.entry_id "                               \
+    "WHERE t.tag_id = ?6 AND t.ignored = 0 AND t.day = ?1 AND (t.position, t.entry_id) < (?2, ?3) " \
+    filter_tags_sql "ORDER BY t.position DESC, t.entry_id DESC LIMIT ?4;"
+
+// Tags of entries that are not cleared, by name, that fit in a tag_t
+#define get_tags_sql                                                                                        \
+    "SELECT id, name FROM tags WHERE length(CAST(name AS BLOB)) < ?2 AND EXISTS (SELECT 1 FROM entry_tags " \
+    "WHERE tag_id = tags.id AND ignored = 0) ORDER BY name LIMIT ?1;"
+
+// Ids are handed out by tday itself, so new entries can be shown before the writer inserts them. Undoing
+// a delete inserts the entry again as it was, updated_at included.
+#define insert_entry_sql                                                           \
+    "INSERT INTO entries (id, description, completed, day, updated_at, position) " \
+    "VALUES (?, ?, ?, ?, ?, ?);"
+
+// Hands out the ids [next, next + ?1) and returns next. Other processes writing to the same database
+// reserve from the same row, so two instances never give the same id to different entries; the max()
+// keeps it ahead of rows inserted without it, e.g. by older versions of tday.
+#define reserve_entry_ids_sql                                                                \
+    "UPDATE entry_ids SET next = max(next, (SELECT ifnull(max(id), 0) + 1 FROM entries)) + ?1 " \
+    "RETURNING next - ?1;"
+
+#define update_entry_sql                                                             \
+    "UPDATE entries "                                                                \
+    "SET description = ?, completed = ?, ignored = ?, updated_at = ?, position = ? " \
+    "WHERE id = ?;"
+
+#define delete_entry_sql "DELETE FROM entries WHERE id = ?;"
+
+// Newest matches first: FTS5 walks its index in rowid order, so the LIMIT ends the query early
+#define search_entries_sql                                                      \
+    "SELECT e.id, e.description, e.completed, e.updated_at, e.day, e.position " \
+    "FROM entries_fts JOIN entries e ON e.id = entries_fts.rowid "              \
+    "WHERE entries_fts MATCH ? AND e.ignored = 0 ORDER BY entries_fts.rowid DESC LIMIT ?;"
+
+#define clear_completed_entries_sql "UPDATE entries SET ignored = ?1 WHERE completed = 1 AND ignored = 0;"
+
+// Brings back the entries of the clear made at ?1. The second term lets it use entries_cleared_idx.
+#define restore_cleared_entries_sql "UPDATE entries SET ignored = 0 WHERE ignored = ?1 AND ignored != 0;"
+
+// Moves every unfinished task of an earlier day to the end of day ?1 in one statement, found through
+// entries_open_idx. They keep their order, oldest day first.
+#define rollover_entries_sql                                                                      \
+    "UPDATE entries SET day = ?1, position = b.last + r.n * 1024 "                                \
+    "FROM (SELECT id, row_number() OVER (ORDER BY day, position, id) AS n FROM entries "          \
+    "WHERE completed = 0 AND ignored = 0 AND day < ?1) AS r, "                                    \
+    "(SELECT ifnull(max(position), 0) AS last FROM entries WHERE day = ?1 AND ignored = 0) AS b " \
+    "WHERE entries.id = r.id;"
+
+// Spreads the positions of day ?1 POSITION_STEP apart again, in the same order. Only the entries whose
+// position changes are written.
+#define rebalance_entries_sql                                                       \
+    "UPDATE entries SET position = r.n * 1024 "                                     \
+    "FROM (SELECT id, row_number() OVER (ORDER BY position, id) AS n FROM entries " \
+    "WHERE day = ?1 AND ignored = 0) AS r "                                         \
+    "WHERE entries.id = r.id AND entries.position != r.n * 1024;"
+
+// Counts of the days from ?1 to ?2, see migrate_daily_stats_v10_sql. Days without a row had nothing happen.
+#define activity_days_sql "SELECT day, created, completed, cleared FROM daily_stats WHERE day BETWEEN ?1 AND ?2;"
+
+// The current streak goes on until today, or until yesterday while nothing is completed today yet. The
+// longest one is the last entry of daily_stats_streak_idx.
+#define activity_streaks_sql                                                                     \
+    "SELECT ifnull((SELECT streak FROM daily_stats WHERE day IN (?1 - 1, ?1) AND completed > 0 " \
+    "ORDER BY day DESC LIMIT 1), 0), ifnull((SELECT max(streak) FROM daily_stats), 0);"
+
+// Archive: cleared entries are moved to their own database, attached as `archive`
+#define create_archive_sql                                                             \
+    "PRAGMA archive.auto_vacuum = INCREMENTAL;"                                        \
+    "CREATE TABLE IF NOT EXISTS archive.entries("                                      \
+    "id INTEGER PRIMARY KEY, "                                                         \
+    "description TEXT NOT NULL, "                                                      \
+    "completed INTEGER, "                                                              \
+    "updated_at INTEGER, "                                                             \
+    "archived_at INTEGER NOT NULL"                                                     \
+    ");"                                                                               \
+    "CREATE INDEX IF NOT EXISTS archive.entries_archived_at_idx ON entries(archived_at);" \
+    "CREATE TEMP TABLE IF NOT EXISTS archive_batch(id INTEGER PRIMARY KEY);"
+
+// Archive files created before the entries grew a day, a sync identity, a position and a priority
+#define migrate_archive_v1_sql                                                    \
+    "ALTER TABLE archive.entries ADD COLUMN day INTEGER NOT NULL DEFAULT 0;"      \
+    "ALTER TABLE archive.entries ADD COLUMN uid TEXT;"                            \
+    "ALTER TABLE archive.entries ADD COLUMN position REAL NOT NULL DEFAULT 0;"    \
+    "ALTER TABLE archive.entries ADD COLUMN priority INTEGER NOT NULL DEFAULT 0;" \
+    "PRAGMA archive.user_version = 1;"
+
+#define ARCHIVE_VERSION 1
+
+// The entry with the highest id is never archived: older versions of tday hand out new ids from
+// max(id) of entries, and archiving it would let them reuse its id. Only entries cleared before ?1
+// are archived, the later ones may still be restored by undo.
+#define has_archivable_entries_sql                                                                      \
+    "SELECT 1 FROM entries WHERE ignored != 0 AND ignored < ?1 AND id < (SELECT max(id) FROM entries) " \
+    "LIMIT 1;"
+
+// A batch whose delete failed leaves its ids behind in temp.archive_batch, the rows are still live and
+// are picked again
+#define pick_archive_batch_sql                                    \
+    "DELETE FROM temp.archive_batch;"                             \
+    "INSERT INTO temp.archive_batch SELECT id FROM main.entries " \
+    "WHERE ignored != 0 AND ignored < %lld AND id < (SELECT max(id) FROM main.entries) LIMIT %d;"
+
+// Rows already copied by a batch that was interrupted or failed before its delete are simply replaced
+#define copy_archive_batch_sql                                                                               \
+    "INSERT OR REPLACE INTO archive.entries "                                                               \
+    "(id, description, completed, updated_at, archived_at, day, uid, position, priority) "                  \
+    "SELECT id, description, completed, updated_at, %lld, day, uid, position, priority FROM main.entries " \
+    "WHERE id IN temp.archive_batch;"
+
+// Archiving is not a change to sync: the other databases archive their cleared entries themselves
+#define delete_archive_batch_sql                               \
+    "UPDATE main.sync_state SET paused = 1;"                   \
+    "DELETE FROM main.entries WHERE id IN temp.archive_batch;" \
+    "UPDATE main.sync_state SET paused = 0;"                   \
+    "DELETE FROM temp.archive_batch;"
+
+#define purge_archive_sql "DELETE FROM archive.entries WHERE archived_at < %lld;"
+
+#define vacuum_archive_sql                \
+    "PRAGMA archive.incremental_vacuum;" \
+    "PRAGMA main.incremental_vacuum;"    \
+    "PRAGMA main.wal_checkpoint(PASSIVE);"
+
+// How long a connection waits for another instance's lock before giving up with SQLITE_BUSY
+#define DB_BUSY_TIMEOUT_MS 5000
+
+// DB, which the UI and the daemon read with, maps up to 256 MiB of the file instead of copying every
+// page it reads out of the page cache of the OS
+#define set_mmap_size_sql "PRAGMA mmap_size = 268435456;"
+
+sqlite3 *DB;
+sqlite3 *WRITER_DB; // connection the mutating statements are prepared on
+sqlite3_stmt *get_entries_after_stmt = NULL;
+sqlite3_stmt *get_entries_before_stmt = NULL;
+sqlite3_stmt *get_filtered_entries_after_stmt = NULL;
+sqlite3_stmt *get_filtered_entries_before_stmt = NULL;
+sqlite3_stmt *get_tagged_entries_after_stmt = NULL;
+sqlite3_stmt *get_tagged_entries_before_stmt = NULL;
+sqlite3_stmt *get_tags_stmt = NULL;
+sqlite3_stmt *insert_entry_stmt = NULL;
+sqlite3_stmt *update_entry_stmt = NULL;
+sqlite3_stmt *delete_entry_stmt = NULL;
+sqlite3_stmt *clear_completed_entries_stmt = NULL;
+sqlite3_stmt *restore_cleared_entries_stmt = NULL;
+sqlite3_stmt *rollover_entries_stmt = NULL;
+sqlite3_stmt *rebalance_entries_stmt = NULL;
+sqlite3_stmt *search_entries_stmt = NULL;
+sqlite3_stmt *activity_days_stmt = NULL;
+sqlite3_stmt *activity_streaks_stmt = NULL;
+
+// Statements are prepared the first time they run: preparing one compiles every trigger it fires, and
+// the first one on a connection parses the whole schema, which starting up would otherwise pay for
+// statements it doesn't run. finalize_read_stmts() and finalize_write_stmts() set them back to NULL.
+// When preparing fails *stmt stays NULL, so callers return right away instead of going through a defer
+// that clears its bindings.
+int prepare_stmt_once(sqlite3 *conn, sqlite3_stmt **stmt, const char *sql, const char *ctx) {
+    if (*stmt != NULL) {
+        return 0;
+    }
+    if (sqlite3_prepare_v2(conn, sql, -1, stmt, 0) != SQLITE_OK) {
+        fprintf(stderr, "[error] %s: %s\n", ctx, sqlite3_errmsg(conn));
+        return 1;
+    }
+    return 0;
+}
+
+#define prepare_read_stmt(name) prepare_stmt_once(DB, &name##_stmt, name##_sql, "prepare_" #name "_stmt")
+#define prepare_write_stmt(name) prepare_stmt_once(WRITER_DB, &name##_stmt, name##_sql, "prepare_" #name "_stmt")
+
+int get_db_version(int *db_version) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    result = sqlite3_prepare_v2(DB, "PRAGMA user_version;", -1, &stmt, 0);
+    if (result != SQLITE_OK) {
+        return_defer(result);
+    }
+    result = sqlite3_step(stmt);
+    if (result != SQLITE_ROW) {
+        return_defer(result);
+    }
+    (*db_version) = sqlite3_column_int(stmt, 0);
+    result = sqlite3_step(stmt);
+    if (result != SQLITE_DONE) {
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// Stats
+//
+// tday measures itself: how long each prepared statement takes to run (through sqlite3_trace_v2),
+// how long a frame takes to draw and how long it takes from reading a key until the resulting frame
+// is written. (s) in the list view shows them, and they are written to stats_file_path on exit.
+
+#define HISTOGRAM_SUB_BUCKETS 8
+#define HISTOGRAM_BUCKETS (1 + 32 * HISTOGRAM_SUB_BUCKETS)
+
+// Log-linear histogram of microsecond samples: every power of two is split in HISTOGRAM_SUB_BUCKETS
+// buckets, so percentiles are within 12.5% of the real value at any scale
+typedef struct Histogram {
+    size_t buckets[HISTOGRAM_BUCKETS];
+    size_t count;
+    double total_us;
+    double max_us;
+} histogram_t;
+
+typedef struct StmtStats {
+    const char *name;
+    sqlite3_stmt **stmt;
+    int writer;        // runs on WRITER_DB, whose thread is the only one to touch stmt
+    double started_us; // the profile callback only has millisecond resolution
+    histogram_t time;
+} stmt_stats_t;
+
+typedef struct Stats {
+    pthread_mutex_t mutex; // statements also run on the writer thread
+    histogram_t render;
+    histogram_t key_to_flush;
+    size_t write_failures; // queued ops the writer could not store, see writer_commit_batch()
+} stats_t;
+
+stats_t stats = {.mutex = PTHREAD_MUTEX_INITIALIZER};
+
+stmt_stats_t stmt_stats[] = {
+    {.name = "get_entries_after", .stmt = &get_entries_after_stmt},
+    {.name = "get_entries_before", .stmt = &get_entries_before_stmt},
+    {.name = "get_filtered_entries_after", .stmt = &get_filtered_entries_after_stmt},
+    {.name = "get_filtered_entries_before", .stmt = &get_filtered_entries_before_stmt},
+    {.name = "get_tagged_entries_after", .stmt = &get_tagged_entries_after_stmt},
+    {.name = "get_tagged_entries_before", .stmt = &get_tagged_entries_before_stmt},
+    {.name = "get_tags", .stmt = &get_tags_stmt},
+    {.name = "search_entries", .stmt = &search_entries_stmt},
+    {.name = "activity_days", .stmt = &activity_days_stmt},
+    {.name = "activity_streaks", .stmt = &activity_streaks_stmt},
+    {.name = "insert_entry", .stmt = &insert_entry_stmt, .writer = 1},
+    {.name = "update_entry", .stmt = &update_entry_stmt, .writer = 1},
+    {.name = "delete_entry", .stmt = &delete_entry_stmt, .writer = 1},
+    {.name = "clear_completed_entries", .stmt = &clear_completed_entries_stmt, .writer = 1},
+    {.name = "restore_cleared_entries", .stmt = &restore_cleared_entries_stmt, .writer = 1},
+    {.name = "rollover_entries", .stmt = &rollover_entries_stmt, .writer = 1},
+    {.name = "rebalance_entries", .stmt = &rebalance_entries_stmt, .writer = 1},
+};
+
+#define STMT_STATS_COUNT ((int)(sizeof(stmt_stats) / sizeof(stmt_stats[0])))
+
+// Most rows stats_draw() can take
+#define STATS_ROWS (3 + STMT_STATS_COUNT)
+
+double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void histogram_add(histogram_t *h, double us) {
+    int bucket = 0;
+    if (us >= 1) {
+        int exp;
+        double frac = frexp(us, &exp); // us = frac * 2^exp, frac in [0.5, 1)
+        bucket = 1 + (exp - 1) * HISTOGRAM_SUB_BUCKETS + (int)((frac * 2 - 1) * HISTOGRAM_SUB_BUCKETS);
+        if (bucket >= HISTOGRAM_BUCKETS) {
+            bucket = HISTOGRAM_BUCKETS - 1;
+        }
+    }
+    h->buckets[bucket]++;
+    h->count++;
+    h->total_us += us;
+    if (us > h->max_us) {
+        h->max_us = us;
+    }
+}
+
+// Upper bound of the bucket holding the p-th percentile (p in [0, 1])
+double histogram_percentile(const histogram_t *h, double p) {
+    if (h->count == 0) {
+        return 0;
+    }
+    size_t rank = (size_t)(p * (h->count - 1)) + 1;
+    size_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            if (i == 0) {
+                return 1;
+            }
+            int exp = (i - 1) / HISTOGRAM_SUB_BUCKETS;
+            int sub = (i - 1) % HISTOGRAM_SUB_BUCKETS;
+            double bound = ldexp(1.0 + (sub + 1.0) / HISTOGRAM_SUB_BUCKETS, exp);
+            return bound < h->max_us ? bound : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+// ctx is non-NULL for WRITER_DB. Only the statements of the tracing connection are looked at, the
+// others may be being prepared on another thread, see prepare_stmt_once().
+int stats_trace(unsigned type, void *ctx, void *p, void *x) {
+    (void)x;
+    sqlite3_stmt *stmt = p;
+    int writer = ctx != NULL;
+    for (int i = 0; i < STMT_STATS_COUNT; i++) {
+        stmt_stats_t *s = &stmt_stats[i];
+        if (s->writer != writer || *s->stmt != stmt) {
+            continue;
+        }
+        pthread_mutex_lock(&stats.mutex);
+        if (type == SQLITE_TRACE_STMT) {
+            // Also fires for every trigger program the statement runs, only the first one counts
+            if (s->started_us == 0) {
+                s->started_us = now_us();
+            }
+        } else if (s->started_us != 0) {
+            histogram_add(&s->time, now_us() - s->started_us);
+            s->started_us = 0;
+        }
+        pthread_mutex_unlock(&stats.mutex);
+        break;
+    }
+    return 0;
+}
+
+void stats_trace_conn(sqlite3 *conn) {
+    sqlite3_trace_v2(conn, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE, stats_trace, conn == WRITER_DB ? conn : NULL);
+}
+
+// Draws the stats overlay from row on, returns the row after it
+int stats_draw(renderer_t *r, int row) {
+    draw_fmt(r, row++, 0, ATTR_YELLOW, "frames %zu, last %zu bytes, avg %.0f bytes, %.2f writes per frame", r->frames,
+             r->last_frame_bytes, r->frames ? (double)r->total_bytes / r->frames : 0.0,
+             r->frames ? (double)r->write_calls / r->frames : 0.0);
+    draw_fmt(r, row++, 0, ATTR_YELLOW, "render p50 %.0fus p99 %.0fus, key to flush p50 %.0fus p99 %.0fus",
+             histogram_percentile(&stats.render, 0.5), histogram_percentile(&stats.render, 0.99),
+             histogram_percentile(&stats.key_to_flush, 0.5), histogram_percentile(&stats.key_to_flush, 0.99));
+    pthread_mutex_lock(&stats.mutex);
+    if (stats.write_failures > 0) {
+        draw_fmt(r, row++, 0, ATTR_YELLOW, "%zu changes could not be saved, see stderr", stats.write_failures);
+    }
+    for (int i = 0; i < STMT_STATS_COUNT; i++) {
+        histogram_t *h = &stmt_stats[i].time;
+        if (h->count == 0) {
+            continue;
+        }
+        draw_fmt(r, row++, 0, ATTR_YELLOW, "%-28s %6zu runs, p50 %.0fus p99 %.0fus max %.0fus", stmt_stats[i].name,
+                 h->count, histogram_percentile(h, 0.5), histogram_percentile(h, 0.99), h->max_us);
+    }
+    pthread_mutex_unlock(&stats.mutex);
+    return row;
+}
+
+// Startup
+//
+// How long each phase of starting up takes, from main() on: the first frame is drawn as soon as the
+// first page is loaded, and the writer is only started after it. `tday --time-startup` prints the
+// phases, and stats_dump() writes them with the other stats.
+
+typedef enum StartupPhase {
+    STARTUP_INIT,        // the terminal and the views set up
+    STARTUP_OPEN,        // the database opened, or the daemon connected to
+    STARTUP_SCHEMA,      // the schema version read, and the schema brought up to date if it wasn't
+    STARTUP_FIRST_PAGE,  // the first page of the list loaded
+    STARTUP_FIRST_FRAME, // the first frame drawn and written
+    STARTUP_WRITER,      // the writer connection opened and its thread started
+    STARTUP_PHASES,
+} startup_phase_t;
+
+static const char *startup_phase_names[STARTUP_PHASES] = {
+    "init", "open", "schema", "first_page", "first_frame", "writer",
+};
+
+typedef struct Startup {
+    double last_us; // when the last phase ended, 0 when startup isn't being timed
+    double phase_us[STARTUP_PHASES];
+} startup_t;
+
+startup_t startup = {0};
+
+void startup_begin(void) {
+    memset(&startup, 0, sizeof(startup));
+    startup.last_us = now_us();
+}
+
+// Ends phase, which took the time since the last one ended
+void startup_mark(startup_phase_t phase) {
+    if (startup.last_us == 0) {
+        return;
+    }
+    double now = now_us();
+    startup.phase_us[phase] += now - startup.last_us;
+    startup.last_us = now;
+}
+
+double startup_until(startup_phase_t phase) {
+    double us = 0;
+    for (int i = 0; i <= (int)phase; i++) {
+        us += startup.phase_us[i];
+    }
+    return us;
+}
+
+void startup_report(FILE *f) {
+    for (int i = 0; i < STARTUP_PHASES; i++) {
+        fprintf(f, "%-12s %8.2fms\n", startup_phase_names[i], startup.phase_us[i] / 1e3);
+    }
+    fprintf(f, "first frame after %.2fms, ready for keys after %.2fms\n", startup_until(STARTUP_FIRST_FRAME) / 1e3,
+            startup_until(STARTUP_WRITER) / 1e3);
+}
+
+void stats_dump_histogram(FILE *f, const char *kind, const char *name, const histogram_t *h) {
+    fprintf(f, "{\"%s\":\"%s\",\"count\":%zu,\"p50_us\":%.1f,\"p99_us\":%.1f,\"mean_us\":%.1f,\"max_us\":%.1f", kind,
+            name, h->count, histogram_percentile(h, 0.5), histogram_percentile(h, 0.99),
+            h->count ? h->total_us / h->count : 0.0, h->max_us);
+}
+
+// Writes every measurement to path as JSON lines. Must run before the statements are finalized.
+int stats_dump(const char *path, const renderer_t *r) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return 1;
+    }
+    fprintf(f,
+            "{\"metric\":\"frames\",\"count\":%zu,\"bytes\":%zu,\"last_frame_bytes\":%zu,\"max_frame_bytes\":%zu,"
+            "\"write_calls\":%zu}\n",
+            r->frames, r->total_bytes, r->last_frame_bytes, r->max_frame_bytes, r->write_calls);
+    stats_dump_histogram(f, "metric", "render", &stats.render);
+    fprintf(f, "}\n");
+    stats_dump_histogram(f, "metric", "key_to_flush", &stats.key_to_flush);
+    fprintf(f, "}\n");
+    fprintf(f, "{\"metric\":\"startup\"");
+    for (int i = 0; i < STARTUP_PHASES; i++) {
+        fprintf(f, ",\"%s_us\":%.1f", startup_phase_names[i], startup.phase_us[i]);
+    }
+    fprintf(f, "}\n");
+    pthread_mutex_lock(&stats.mutex);
+    fprintf(f, "{\"metric\":\"writer\",\"failed_ops\":%zu}\n", stats.write_failures);
+    for (int i = 0; i < STMT_STATS_COUNT; i++) {
+        sqlite3_stmt *stmt = *stmt_stats[i].stmt;
+        stats_dump_histogram(f, "stmt", stmt_stats[i].name, &stmt_stats[i].time);
+        if (stmt != NULL) {
+            fprintf(f, ",\"vm_steps\":%d,\"fullscan_steps\":%d,\"sorts\":%d",
+                    sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 0),
+                    sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0),
+                    sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 0));
+        }
+        fprintf(f, "}\n");
+    }
+    pthread_mutex_unlock(&stats.mutex);
+    return fclose(f) != 0;
+}
+
+// Migrations, applied in order. A database at user_version N has migrations[0..N) applied.
+typedef struct Migration {
+    const char *name;
+    const char *sql;
+} migration_t;
+
+static const migration_t migrations[] = {
+    {"migrate_table_entries_v1", migrate_table_entries_v1_sql},
+    {"migrate_list_index_v2", migrate_list_index_v2_sql},
+    {"migrate_entries_fts_v3", migrate_entries_fts_v3_sql},
+    {"migrate_cleared_index_v4", migrate_cleared_index_v4_sql},
+    {"migrate_entry_ids_v5", migrate_entry_ids_v5_sql},
+    {"migrate_entries_day_v6", migrate_entries_day_v6_sql},
+    {"migrate_cleared_at_v7", migrate_cleared_at_v7_sql},
+    {"migrate_change_log_v8", migrate_change_log_v8_sql},
+    {"migrate_entries_position_v9", migrate_entries_position_v9_sql},
+    {"migrate_daily_stats_v10", migrate_daily_stats_v10_sql},
+    {"migrate_tags_v11", migrate_tags_v11_sql},
+    {"migrate_tag_list_v12", migrate_tag_list_v12_sql},
+};
+
+#define MIGRATIONS_COUNT ((int)(sizeof(migrations) / sizeof(migrations[0])))
+
+// Brings the schema up to date, one transaction per migration. Sets *migrated when anything ran.
+// Each migration takes the write lock first and checks the version again under it, so two instances
+// started at once don't both run the same migration.
+int run_migrations(int *migrated) {
+    int result = 0;
+    int db_version;
+    (*migrated) = 0;
+    result = get_db_version(&db_version);
+    if (result != 0) {
+        fprintf(stderr, "[error] get_db_version: %s\n", sqlite3_errmsg(DB));
+        return_defer(result);
+    }
+    if (db_version > MIGRATIONS_COUNT) {
+        fprintf(stderr, "[error] run_migrations: database version %d is newer than this tday (%d)\n", db_version,
+                MIGRATIONS_COUNT);
+        return_defer(1);
+    }
+    for (; db_version < MIGRATIONS_COUNT; db_version++) {
+        char set_version_sql[64];
+        snprintf(set_version_sql, sizeof(set_version_sql), "PRAGMA user_version = %d;", db_version + 1);
+        int current_version = db_version;
+        result = sqlite3_exec(DB, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+        if (result == SQLITE_OK) {
+            result = get_db_version(&current_version);
+        }
+        if (result == SQLITE_OK && current_version != db_version) {
+            // Another instance got there first
+            sqlite3_exec(DB, "ROLLBACK;", NULL, NULL, NULL);
+            db_version = current_version - 1;
+            continue;
+        }
+        if (result == SQLITE_OK) {
+            result = sqlite3_exec(DB, migrations[db_version].sql, NULL, NULL, NULL);
+        }
+        if (result == SQLITE_OK) {
+            result = sqlite3_exec(DB, set_version_sql, NULL, NULL, NULL);
+        }
+        if (result == SQLITE_OK) {
+            result = sqlite3_exec(DB, "COMMIT;", NULL, NULL, NULL);
+        }
+        if (result != SQLITE_OK) {
+            fprintf(stderr, "[error] %s: %s\n", migrations[db_version].name, sqlite3_errmsg(DB));
+            sqlite3_exec(DB, "ROLLBACK;", NULL, NULL, NULL);
+            return_defer(result);
+        }
+        (*migrated) = 1;
+    }
+    return_defer(0);
+defer:
+    return result;
+}
+
+// Checks that every list query is answered by an index search, without scanning the table or
+// sorting in a temp B-tree. Returns the number of offending queries, or -1 on error.
+// `make check` runs it on a fresh database through tday-bench -p.
+int check_list_query_plan(void) {
+    static const char *list_queries[] = {
+        get_entries_after_sql,
+        get_entries_before_sql,
+        get_filtered_entries_after_sql,
+        get_filtered_entries_before_sql,
+        get_tagged_entries_after_sql,
+        get_tagged_entries_before_sql,
+    };
+    int offending = 0;
+    for (size_t i = 0; i < sizeof(list_queries) / sizeof(list_queries[0]); i++) {
+        char sql[1024];
+        snprintf(sql, sizeof(sql), "EXPLAIN QUERY PLAN %s", list_queries[i]);
+        sqlite3_stmt *stmt = NULL;
+        if (sqlite3_prepare_v2(DB, sql, -1, &stmt, 0) != SQLITE_OK) {
+            fprintf(stderr, "[error] prepare_explain_query_plan: %s\n", sqlite3_errmsg(DB));
+            return -1;
+        }
+        int ok = 1;
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            const char *detail = (const char *)sqlite3_column_text(stmt, 3);
+            if (strstr(detail, "TEMP B-TREE") != NULL || strncmp(detail, "SCAN", 4) == 0) {
+                fprintf(stderr, "[error] list query plan regressed: %s\n    in: %s\n", detail, list_queries[i]);
+                ok = 0;
+            }
+        }
+        sqlite3_finalize(stmt);
+        offending += !ok;
+    }
+    return offending;
+}
+
+int new_entry(entry_t *entry) {
+    int result = prepare_write_stmt(insert_entry);
+    if (result != 0) {
+        return result;
+    }
+    result = sqlite3_bind_int(insert_entry_stmt, 1, entry->id);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_id_insert_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_bind_text(insert_entry_stmt, 2, entry->description, -1, SQLITE_STATIC);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_insert_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_bind_int(insert_entry_stmt, 3, entry->completed);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_completed_insert_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_bind_int(insert_entry_stmt, 4, entry->day);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_day_insert_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    if (entry->updated_at != 0) {
+        result = sqlite3_bind_int64(insert_entry_stmt, 5, entry->updated_at);
+        if (result != SQLITE_OK) {
+            fprintf(stderr, "[error] bind_updated_at_insert_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+            return_defer(result);
+        }
+    }
+    result = sqlite3_bind_double(insert_entry_stmt, 6, entry->position);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_position_insert_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_step(insert_entry_stmt);
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_insert_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(1);
+    }
+    return_defer(0);
+defer:
+    sqlite3_clear_bindings(insert_entry_stmt);
+    sqlite3_reset(insert_entry_stmt);
+    return result;
+}
+
+int update_entry(entry_t *entry) {
+    int result = prepare_write_stmt(update_entry);
+    if (result != 0) {
+        return result;
+    }
+    result = sqlite3_bind_text(update_entry_stmt, 1, entry->description, -1, SQLITE_STATIC);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_description_update_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_bind_int(update_entry_stmt, 2, entry->completed);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_completed_update_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_bind_int(update_entry_stmt, 3, entry->ignored);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_completed_update_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_bind_int64(update_entry_stmt, 4, entry->updated_at);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_updated_at_update_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_bind_double(update_entry_stmt, 5, entry->position);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_position_update_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_bind_int(update_entry_stmt, 6, entry->id);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_where_id_update_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_step(update_entry_stmt);
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_update_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    sqlite3_reset(update_entry_stmt);
+    sqlite3_clear_bindings(update_entry_stmt);
+    return result;
+}
+
+int delete_entry(entry_t *entry) {
+    int result = prepare_write_stmt(delete_entry);
+    if (result != 0) {
+        return result;
+    }
+    result = sqlite3_bind_int(delete_entry_stmt, 1, entry->id);
+    if (result != SQLITE_OK) {
+        fprintf(stderr, "[error] bind_where_id_delete_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    result = sqlite3_step(delete_entry_stmt);
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_delete_entry_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    sqlite3_reset(delete_entry_stmt);
+    sqlite3_clear_bindings(delete_entry_stmt);
+    return result;
+}
+
+// Clears every completed entry, stamping it with cleared_at, see migrate_cleared_at_v7_sql
+int clear_completed_entries(sqlite3_int64 cleared_at) {
+    int result = prepare_write_stmt(clear_completed_entries);
+    if (result != 0) {
+        return result;
+    }
+    sqlite3_bind_int64(clear_completed_entries_stmt, 1, cleared_at);
+    result = sqlite3_step(clear_completed_entries_stmt);
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_clear_completed_entries_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    sqlite3_reset(clear_completed_entries_stmt);
+    return result;
+}
+
+// Brings back the entries cleared at cleared_at that are not archived yet
+int restore_cleared_entries(sqlite3_int64 cleared_at) {
+    int result = prepare_write_stmt(restore_cleared_entries);
+    if (result != 0) {
+        return result;
+    }
+    sqlite3_bind_int64(restore_cleared_entries_stmt, 1, cleared_at);
+    result = sqlite3_step(restore_cleared_entries_stmt);
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_restore_cleared_entries_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    sqlite3_reset(restore_cleared_entries_stmt);
+    return result;
+}
+
+// Moves the unfinished tasks of every day before day to day
+int rollover_entries(int day) {
+    int result = prepare_write_stmt(rollover_entries);
+    if (result != 0) {
+        return result;
+    }
+    sqlite3_bind_int(rollover_entries_stmt, 1, day);
+    result = sqlite3_step(rollover_entries_stmt);
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_rollover_entries_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    sqlite3_reset(rollover_entries_stmt);
+    return result;
+}
+
+// Spreads out the positions of day's entries, see rebalance_entries_sql
+int rebalance_entries(int day) {
+    int result = prepare_write_stmt(rebalance_entries);
+    if (result != 0) {
+        return result;
+    }
+    sqlite3_bind_int(rebalance_entries_stmt, 1, day);
+    result = sqlite3_step(rebalance_entries_stmt);
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_rebalance_entries_stmt: %s\n", sqlite3_errmsg(WRITER_DB));
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    sqlite3_reset(rebalance_entries_stmt);
+    return result;
+}
+
+// Reserves the ids [*first, *first + n) on conn, see reserve_entry_ids_sql. Returns SQLITE_BUSY,
+// without reporting it, when another instance kept the write lock past the busy timeout.
+int reserve_entry_ids(sqlite3 *conn, int n, sqlite3_int64 *first) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    check_conn_err(conn, sqlite3_prepare_v2(conn, reserve_entry_ids_sql, -1, &stmt, 0), "prepare_reserve_entry_ids");
+    sqlite3_bind_int(stmt, 1, n);
+    result = sqlite3_step(stmt);
+    if (result == SQLITE_BUSY) {
+        return_defer(result);
+    }
+    if (result != SQLITE_ROW) {
+        fprintf(stderr, "[error] step_reserve_entry_ids: %s\n", sqlite3_errmsg(conn));
+        return_defer(1);
+    }
+    (*first) = sqlite3_column_int64(stmt, 0);
+    return_defer(0);
+defer:
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// Archive
+//
+// Clearing only flags entries as ignored. They are then moved, ARCHIVE_BATCH_ROWS at a time, to the
+// archive database at archive_file_path and deleted from entries, so the tables and indexes the list
+// reads from only ever hold live tasks. The writer thread archives in the background whenever it has
+// nothing else to do; `tday archive` does the same in the foreground.
+//
+// Each batch is copied in one transaction and deleted in another: a crash or an error in between
+// leaves the rows in both databases, and the next batch copies them again. One transaction would not
+// be safer, SQLite doesn't commit attached databases atomically when one of them is in WAL mode, and
+// the delete could then be committed without the copy.
+
+#define ARCHIVE_BATCH_ROWS 500
+
+int get_archive_version(sqlite3 *conn, int *version) {
+    sqlite3_stmt *stmt = NULL;
+    int result = sqlite3_prepare_v2(conn, "PRAGMA archive.user_version;", -1, &stmt, 0);
+    if (result == SQLITE_OK) {
+        result = sqlite3_step(stmt) == SQLITE_ROW ? SQLITE_OK : sqlite3_errcode(conn);
+    }
+    if (result == SQLITE_OK) {
+        (*version) = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// Adds the columns archive files made by older versions of tday lack. The version is checked again
+// under the write lock, like run_migrations() does for the main database.
+int migrate_archive(sqlite3 *conn) {
+    int version;
+    int result = get_archive_version(conn, &version);
+    if (result != SQLITE_OK || version >= ARCHIVE_VERSION) {
+        return result;
+    }
+    result = sqlite3_exec(conn, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+    if (result == SQLITE_OK) {
+        result = get_archive_version(conn, &version);
+    }
+    if (result == SQLITE_OK && version < ARCHIVE_VERSION) {
+        result = sqlite3_exec(conn, migrate_archive_v1_sql, NULL, NULL, NULL);
+    }
+    if (result == SQLITE_OK) {
+        result = sqlite3_exec(conn, "COMMIT;", NULL, NULL, NULL);
+    }
+    if (result != SQLITE_OK && !sqlite3_get_autocommit(conn)) {
+        sqlite3_exec(conn, "ROLLBACK;", NULL, NULL, NULL);
+    }
+    return result;
+}
+
+// Attaches the archive database to conn as `archive`, creating it on first use
+int attach_archive(sqlite3 *conn) {
+    int result = 0;
+    if (sqlite3_db_filename(conn, "archive") != NULL) {
+        return 0;
+    }
+    char *attach_sql = sqlite3_mprintf("ATTACH DATABASE %Q AS archive;", archive_file_path);
+    if (attach_sql == NULL) {
+        return 1;
+    }
+    check_conn_err(conn, sqlite3_exec(conn, attach_sql, NULL, NULL, NULL), "attach_archive");
+    check_conn_err(conn, sqlite3_exec(conn, create_archive_sql, NULL, NULL, NULL), "create_archive");
+    check_conn_err(conn, migrate_archive(conn), "migrate_archive");
+    return_defer(0);
+defer:
+    sqlite3_free(attach_sql);
+    return result;
+}
+
+int has_archivable_entries(sqlite3 *conn, sqlite3_int64 cleared_before) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(conn, has_archivable_entries_sql, -1, &stmt, 0) != SQLITE_OK) {
+        return 0;
+    }
+    sqlite3_bind_int64(stmt, 1, cleared_before);
+    int found = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+// Moves up to ARCHIVE_BATCH_ROWS entries of conn's database that were cleared before cleared_before
+// to the archive. Returns the number of entries moved, or -1 on error.
+int archive_entries(sqlite3 *conn, sqlite3_int64 cleared_before) {
+    int result = 0;
+    int moved = 0;
+    char sql[512];
+    if (!has_archivable_entries(conn, cleared_before)) {
+        return 0;
+    }
+    if (attach_archive(conn) != 0) {
+        return -1;
+    }
+    check_conn_err(conn, sqlite3_exec(conn, "BEGIN IMMEDIATE;", NULL, NULL, NULL), "begin_archive_batch");
+    snprintf(sql, sizeof(sql), pick_archive_batch_sql, (long long)cleared_before, ARCHIVE_BATCH_ROWS);
+    check_conn_err(conn, sqlite3_exec(conn, sql, NULL, NULL, NULL), "pick_archive_batch");
+    moved = sqlite3_changes(conn);
+    snprintf(sql, sizeof(sql), copy_archive_batch_sql "COMMIT;", (long long)time(NULL));
+    check_conn_err(conn, sqlite3_exec(conn, sql, NULL, NULL, NULL), "copy_archive_batch");
+    check_conn_err(conn, sqlite3_exec(conn, "BEGIN IMMEDIATE;" delete_archive_batch_sql "COMMIT;", NULL, NULL, NULL),
+                   "delete_archive_batch");
+    return_defer(0);
+defer:
+    if (result != 0) {
+        if (!sqlite3_get_autocommit(conn)) {
+            sqlite3_exec(conn, "ROLLBACK;", NULL, NULL, NULL);
+        }
+        return -1;
+    }
+    return moved;
+}
+
+// Deletes archived entries older than archive_retention_days, then gives the free pages of both
+// databases back to the file system
+int archive_compact(sqlite3 *conn) {
+    int result = 0;
+    if (attach_archive(conn) != 0) {
+        return 1;
+    }
+    if (archive_retention_days > 0) {
+        char sql[128];
+        snprintf(sql, sizeof(sql), purge_archive_sql, (long long)time(NULL) - archive_retention_days * 86400LL);
+        check_conn_err(conn, sqlite3_exec(conn, sql, NULL, NULL, NULL), "purge_archive");
+    }
+    check_conn_err(conn, sqlite3_exec(conn, vacuum_archive_sql, NULL, NULL, NULL), "vacuum_archive");
+    return_defer(0);
+defer:
+    return result;
+}
+
+// Client
+//
+// With a daemon running (`tday --daemon`, see the Daemon section), the interactive list connects to it
+// over the Unix socket at socket_file_path instead of opening the database, and every read and write
+// the list makes becomes a request. The protocol is line based, so scripts can speak it too. A request
+// is one line, a verb and its arguments separated by spaces; the reply is `OK`, followed by a value on
+// the same line for some verbs, or `ERR message`. Replies that carry entries are `OK n` and then one
+// line per entry, `id completed day updated_at position description`. Descriptions always come last,
+// with backslashes and newlines escaped as `\\` and `\n`.
+//
+//   PAGE day direction max [id position]  entries of day after or before an entry, see load_entries()
+//   SEARCH max query                      entries matching what the user typed, see search_entries()
+//   WRITE op ignored id completed day updated_at position description  queues a write op, see writer_push()
+//   ID                                                an unused entry id
+//   CHANGED                                           1 if the tasks changed since the client last asked, other
+//                                                     than by the client itself, 0 otherwise
+//   HOLD cleared_at                                   see writer_hold_archive()
+//   FILTER priority [tag_id name]...                 filters the entries of the next PAGE requests, see
+//                                                     filter_t
+//   TAGS max                                          `OK n`, then one `tag_id name` line per tag, see load_tags()
+//   ACTIVITY end today                                `OK streak longest_streak`, then one line per day and
+//                                                     per week, `day created completed cleared`, see
+//                                                     load_activity()
+
+#define CLIENT_READ_SIZE 4096
+
+typedef struct Buffer {
+    char *data;
+    size_t len;
+    size_t cap;
+} buffer_t;
+
+// Makes room for n more bytes
+int buffer_reserve(buffer_t *b, size_t n) {
+    if (b->len + n <= b->cap) {
+        return 0;
+    }
+    size_t cap = b->cap > 0 ? b->cap : 256;
+    while (cap < b->len + n) {
+        cap *= 2;
+    }
+    char *data = realloc(b->data, cap);
+    if (data == NULL) {
+        return 1;
+    }
+    b->data = data;
+    b->cap = cap;
+    return 0;
+}
+
+int buffer_append(buffer_t *b, const char *s, size_t n) {
+    if (buffer_reserve(b, n) != 0) {
+        return 1;
+    }
+    memcpy(b->data + b->len, s, n);
+    b->len += n;
+    return 0;
+}
+
+// Appends a short formatted string: verbs, numbers and the like
+int buffer_fmt(buffer_t *b, const char *fmt, ...) {
+    char tmp[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, args);
+    va_end(args);
+    if (n < 0 || n >= (int)sizeof(tmp)) {
+        return 1;
+    }
+    return buffer_append(b, tmp, n);
+}
+
+// Appends len bytes of s with backslashes and newlines escaped
+int buffer_append_escaped(buffer_t *b, const char *s, size_t len) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] != '\\' && s[i] != '\n') {
+            continue;
+        }
+        if (buffer_append(b, s + start, i - start) != 0 || buffer_append(b, s[i] == '\n' ? "\\n" : "\\\\", 2) != 0) {
+            return 1;
+        }
+        start = i + 1;
+    }
+    return buffer_append(b, s + start, len - start);
+}
+
+void buffer_free(buffer_t *b) {
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+int buffer_append_entry(buffer_t *b, const entry_t *entry) {
+    const char *description = entry->description != NULL ? entry->description : "";
+    if (buffer_fmt(b, "%d %d %d %lld %.17g ", entry->id, entry->completed, entry->day, (long long)entry->updated_at,
+                   entry->position) != 0 ||
+        buffer_append_escaped(b, description, strlen(description)) != 0) {
+        return 1;
+    }
+    return buffer_append(b, "\n", 1);
+}
+
+// Undoes buffer_append_escaped() in place
+void unescape_text(char *s) {
+    char *out = s;
+    for (; *s != '\0'; s++) {
+        if (*s == '\\' && s[1] != '\0') {
+            s++;
+            *out++ = *s == 'n' ? '\n' : *s;
+        } else {
+            *out++ = *s;
+        }
+    }
+    *out = '\0';
+}
+
+// Parses the integer at *p and moves *p past it and the space after it. Returns 0 on success.
+int parse_field(char **p, sqlite3_int64 *value) {
+    char *end;
+    errno = 0;
+    *value = strtoll(*p, &end, 10);
+    if (end == *p || errno != 0 || (*end != ' ' && *end != '\0')) {
+        return 1;
+    }
+    *p = *end == ' ' ? end + 1 : end;
+    return 0;
+}
+
+// Parses the number at *p like parse_field()
+int parse_position(char **p, double *value) {
+    char *end;
+    errno = 0;
+    *value = strtod(*p, &end);
+    if (end == *p || errno != 0 || (*end != ' ' && *end != '\0')) {
+        return 1;
+    }
+    *p = *end == ' ' ? end + 1 : end;
+    return 0;
+}
+
+// Parses an entry line in place, see buffer_append_entry(). The description points into line.
+int parse_entry_line(char *line, entry_t *entry) {
+    sqlite3_int64 id, completed, day, updated_at;
+    double position;
+    char *p = line;
+    if (parse_field(&p, &id) != 0 || parse_field(&p, &completed) != 0 || parse_field(&p, &day) != 0 ||
+        parse_field(&p, &updated_at) != 0 || parse_position(&p, &position) != 0) {
+        return 1;
+    }
+    memset(entry, 0, sizeof(*entry));
+    entry->id = id;
+    entry->completed = completed != 0;
+    entry->day = day;
+    entry->updated_at = updated_at;
+    entry->position = position;
+    unescape_text(p);
+    entry->description = p;
+    return 0;
+}
+
+typedef struct Client {
+    int fd;          // -1 unless connected to a daemon
+    int lost;        // the connection broke, every request fails from then on
+    buffer_t out;    // the request being built
+    buffer_t in;     // bytes of the reply read so far
+    size_t in_pos;   // start of the first line of in not returned yet
+    filter_t filter; // what the daemon filters the client's pages with, see FILTER
+} client_t;
+
+client_t client = {.fd = -1};
+
+// Connects to the daemon listening at path. Returns 0 on success.
+int client_connect(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return 1;
+    }
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return 1;
+    }
+    client.fd = fd;
+    return 0;
+}
+
+void client_close(void) {
+    if (client.fd >= 0) {
+        close(client.fd);
+    }
+    buffer_free(&client.out);
+    buffer_free(&client.in);
+    memset(&client, 0, sizeof(client));
+    client.fd = -1;
+}
+
+void client_lost(const char *ctx) {
+    if (!client.lost) {
+        fprintf(stderr, "[error] %s: lost the connection to the daemon\n", ctx);
+    }
+    client.lost = 1;
+}
+
+// Reads the next line of the reply and returns it NUL terminated, valid until the next call
+char *client_read_line(void) {
+    while (1) {
+        char *start = client.in.data + client.in_pos;
+        char *end = client.in.len > client.in_pos ? memchr(start, '\n', client.in.len - client.in_pos) : NULL;
+        if (end != NULL) {
+            *end = '\0';
+            client.in_pos = end + 1 - client.in.data;
+            return start;
+        }
+        // Keep the start of the line and read the rest after it
+        client.in.len -= client.in_pos;
+        if (client.in.len > 0) {
+            memmove(client.in.data, start, client.in.len);
+        }
+        client.in_pos = 0;
+        if (buffer_reserve(&client.in, CLIENT_READ_SIZE) != 0) {
+            return NULL;
+        }
+        ssize_t n = read(client.fd, client.in.data + client.in.len, client.in.cap - client.in.len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            client_lost("client_read_line");
+            return NULL;
+        }
+        client.in.len += n;
+    }
+}
+
+// Sends the request built in client.out and waits for the reply. Returns the rest of the reply line
+// after `OK`, or NULL when the request failed.
+char *client_call(void) {
+    size_t sent = 0;
+    while (!client.lost && sent < client.out.len) {
+        ssize_t n = send(client.fd, client.out.data + sent, client.out.len - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            client_lost("client_call");
+        }
+        sent += n > 0 ? n : 0;
+    }
+    client.out.len = 0;
+    char *line = client.lost ? NULL : client_read_line();
+    if (line == NULL) {
+        return NULL;
+    }
+    if (strncmp(line, "OK", 2) != 0) {
+        fprintf(stderr, "[error] client_call: %s\n", line);
+        return NULL;
+    }
+    return line[2] == ' ' ? line + 3 : line + 2;
+}
+
+// Reads the entry lines of an `OK n` reply, copying the descriptions into arena. Every line is read
+// even when they don't fit, so the next reply starts where it should.
+int client_read_entries(const char *reply, entry_t *entries, int max, int *entries_sz, arena_t *arena) {
+    int result = 0;
+    int n = atoi(reply);
+    *entries_sz = 0;
+    for (int i = 0; i < n; i++) {
+        char *line = client_read_line();
+        if (line == NULL) {
+            return 1;
+        }
+        entry_t entry;
+        if (result != 0 || *entries_sz == max || parse_entry_line(line, &entry) != 0) {
+            result = 1;
+            continue;
+        }
+        entry.description = arena_strndup(arena, entry.description, strlen(entry.description));
+        if (entry.description == NULL) {
+            result = 1;
+            continue;
+        }
+        entries[(*entries_sz)++] = entry;
+    }
+    return result;
+}
+
+// Has the daemon filter the next pages with filter, unless it already does
+int client_set_filter(const filter_t *filter) {
+    filter_t none = {0};
+    if (filter == NULL) {
+        filter = &none;
+    }
+    if (filter_eq(filter, &client.filter)) {
+        return 0;
+    }
+    int err = buffer_fmt(&client.out, "FILTER %d", filter->priority);
+    for (int i = 0; i < filter->tags_sz; i++) {
+        err |= buffer_fmt(&client.out, " %d %s", filter->tags[i].id, filter->tags[i].name);
+    }
+    err |= buffer_append(&client.out, "\n", 1);
+    if (err != 0 || client_call() == NULL) {
+        return 1;
+    }
+    client.filter = *filter;
+    return 0;
+}
+
+int client_load_entries(int day, const filter_t *filter, const entry_t *from, int direction, entry_t *entries,
+                        int max, int *entries_sz, arena_t *arena) {
+    *entries_sz = 0;
+    if (client_set_filter(filter) != 0) {
+        return 1;
+    }
+    int err = buffer_fmt(&client.out, "PAGE %d %d %d", day, direction, max);
+    if (from != NULL) {
+        err |= buffer_fmt(&client.out, " %d %.17g", from->id, from->position);
+    }
+    err |= buffer_append(&client.out, "\n", 1);
+    char *reply = err == 0 ? client_call() : NULL;
+    return reply == NULL || client_read_entries(reply, entries, max, entries_sz, arena) != 0;
+}
+
+int client_search(const char *input, int len, entry_t *entries, int max, int *entries_sz, arena_t *arena) {
+    *entries_sz = 0;
+    int err = buffer_fmt(&client.out, "SEARCH %d ", max);
+    err |= buffer_append_escaped(&client.out, input, len);
+    err |= buffer_append(&client.out, "\n", 1);
+    char *reply = err == 0 ? client_call() : NULL;
+    return reply == NULL || client_read_entries(reply, entries, max, entries_sz, arena) != 0;
+}
+
+int client_load_tags(tag_t *tags, int max, int *tags_sz) {
+    *tags_sz = 0;
+    char *reply = buffer_fmt(&client.out, "TAGS %d\n", max) == 0 ? client_call() : NULL;
+    if (reply == NULL) {
+        return 1;
+    }
+    // Every line is read even after a bad one, so the next reply starts where it should
+    int result = 0;
+    int n = atoi(reply);
+    for (int i = 0; i < n; i++) {
+        char *line = client_read_line();
+        if (line == NULL) {
+            return 1;
+        }
+        tag_t *tag = &tags[*tags_sz];
+        char *name = strchr(line, ' ');
+        if (result != 0 || *tags_sz == max || name == NULL || strlen(name + 1) >= TAG_NAME_SIZE) {
+            result = 1;
+            continue;
+        }
+        tag->id = atoi(line);
+        strcpy(tag->name, name + 1);
+        (*tags_sz)++;
+    }
+    return result;
+}
+
+int client_load_activity(int end, int today, activity_t *activity) {
+    int err = buffer_fmt(&client.out, "ACTIVITY %d %d\n", end, today);
+    char *reply = err == 0 ? client_call() : NULL;
+    if (reply == NULL || sscanf(reply, "%d %d", &activity->streak, &activity->longest_streak) != 2) {
+        return 1;
+    }
+    // Every line is read even after a bad one, so the next reply starts where it should
+    int result = 0;
+    for (int i = 0; i < ACTIVITY_DAYS + ACTIVITY_WEEKS; i++) {
+        day_counts_t *counts = i < ACTIVITY_DAYS ? &activity->days[i] : &activity->weeks[i - ACTIVITY_DAYS];
+        char *line = client_read_line();
+        if (line == NULL) {
+            return 1;
+        }
+        if (sscanf(line, "%d %d %d %d", &counts->day, &counts->created, &counts->completed, &counts->cleared) != 4) {
+            result = 1;
+        }
+    }
+    return result;
+}
+
+// Sends a write op, see write_op_type_t. The daemon queues it and replies right away.
+int client_push(int type, const entry_t *entry) {
+    entry_t none = {0};
+    if (entry == NULL) {
+        entry = &none;
+    }
+    int err = buffer_fmt(&client.out, "WRITE %d %d ", type, entry->ignored);
+    err |= buffer_append_entry(&client.out, entry);
+    return err != 0 || client_call() == NULL;
+}
+
+sqlite3_int64 client_new_entry_id(void) {
+    char *reply = buffer_append(&client.out, "ID\n", 3) == 0 ? client_call() : NULL;
+    return reply != NULL ? strtoll(reply, NULL, 10) : 0;
+}
+
+// Whether anything else changed the tasks since the last call: 1 if so, 0 if not, -1 on error
+int client_check_changes(void) {
+    char *reply = buffer_append(&client.out, "CHANGED\n", 8) == 0 ? client_call() : NULL;
+    return reply != NULL ? atoi(reply) : -1;
+}
+
+int client_hold_archive(sqlite3_int64 cleared_at) {
+    return buffer_fmt(&client.out, "HOLD %lld\n", (long long)cleared_at) != 0 || client_call() == NULL;
+}
+
+// Writer
+//
+// Mutations are persisted by a writer thread that owns its own connection to the database, in WAL
+// mode. The UI pushes them onto a bounded queue and moves on; the writer commits everything that
+// piled up during WRITER_COMMIT_INTERVAL_MS in a single transaction, so a burst of keypresses costs
+// one commit.
+
+#define WRITER_QUEUE_CAP 256
+#define WRITER_COMMIT_INTERVAL_MS 50
+#define WRITER_MAX_ATTEMPTS 5
+#define WRITER_RETRY_MS 100
+#define ENTRY_ID_BLOCK 16
+
+typedef enum WriteOpType {
+    WRITE_INSERT,
+    WRITE_UPDATE,
+    WRITE_DELETE,
+    WRITE_CLEAR_COMPLETED,  // entry.updated_at is the time of the clear
+    WRITE_RESTORE_CLEARED,  // entry.updated_at is the time of the clear to undo
+    WRITE_ROLLOVER,         // entry.day is the day to roll over to
+    WRITE_REBALANCE,        // entry.day is the day to rebalance, see list_move_selected()
+} write_op_type_t;
+
+typedef struct WriteOp {
+    write_op_type_t type;
+    entry_t entry;
+    char *description; // the op's own copy of entry.description
+} write_op_t;
+
+typedef struct Writer {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake; // signaled when ops are pushed or a flush is requested
+    pthread_cond_t idle; // signaled when the writer takes ops off the queue or commits them
+    write_op_t ops[WRITER_QUEUE_CAP];
+    int head;
+    int count;
+    int in_flight; // ops taken off the queue but not committed yet, the first ones of batch
+    write_op_t batch[WRITER_QUEUE_CAP];
+    int stale_reads; // a read went ahead of pending ops, notify once they are committed, see writer_read_ahead()
+    int flush;
+    int stopping;
+    int running;
+    int archive_pending; // cleared entries may be waiting to be archived
+    sqlite3_int64 archive_before; // only entries cleared before this are archived, see writer_hold_archive
+    int want_ids;        // the UI took the spare block of entry ids, reserve the next one
+    int check_changes;   // the UI asks whether another process committed, see writer_poll_data_version
+    int ids_failed;      // the last reservation gave up
+    sqlite3_int64 spare_ids; // first id of a reserved block the UI hasn't taken yet, 0 if none
+    sqlite3_stmt *data_version_stmt;
+    int data_version;
+    int notify[2]; // a byte is written to notify[1] when another process commits to the database, after
+                   // a rebalance moved entries the UI has loaded, when ops could not be stored, or when
+                   // reads that went ahead of them can be done again
+    size_t commits;
+} writer_t;
+
+writer_t writer = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+    .notify = {-1, -1},
+    .archive_before = LLONG_MAX,
+};
+
+// Ids [next_entry_id, entry_id_limit) are reserved for this process
+sqlite3_int64 next_entry_id = 0;
+sqlite3_int64 entry_id_limit = 0;
+
+int write_op_apply(write_op_t *op) {
+    switch (op->type) {
+    case WRITE_INSERT:
+        return new_entry(&op->entry);
+    case WRITE_UPDATE:
+        return update_entry(&op->entry);
+    case WRITE_DELETE:
+        return delete_entry(&op->entry);
+    case WRITE_CLEAR_COMPLETED:
+        return clear_completed_entries(op->entry.updated_at);
+    case WRITE_RESTORE_CLEARED:
+        return restore_cleared_entries(op->entry.updated_at);
+    case WRITE_ROLLOVER:
+        return rollover_entries(op->entry.day);
+    case WRITE_REBALANCE:
+        return rebalance_entries(op->entry.day);
+    }
+    return 1;
+}
+
+void writer_deadline(struct timespec *ts) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_nsec += WRITER_COMMIT_INTERVAL_MS * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec += ts->tv_nsec / 1000000000L;
+        ts->tv_nsec %= 1000000000L;
+    }
+}
+
+// PRAGMA data_version changes whenever another connection commits to the database, and reading it
+// touches nothing but the shared-memory index of the WAL. The writer's connection makes every commit
+// this process does, so any change it sees comes from another instance.
+void writer_poll_data_version(void) {
+    if (sqlite3_step(writer.data_version_stmt) == SQLITE_ROW) {
+        int version = sqlite3_column_int(writer.data_version_stmt, 0);
+        if (version != writer.data_version) {
+            writer.data_version = version;
+            if (write(writer.notify[1], "", 1) < 0 && errno != EAGAIN) {
+                fprintf(stderr, "[error] writer_notify: %s\n", strerror(errno));
+            }
+        }
+    }
+    sqlite3_reset(writer.data_version_stmt);
+}
+
+// Applies a batch in one transaction. BEGIN IMMEDIATE waits up to DB_BUSY_TIMEOUT_MS for another
+// instance to release the write lock; if it is still held, or the commit fails because of it, the
+// whole batch is rolled back and tried again a little later. Returns the number of failed ops.
+//
+// The batch commits partially: an op that fails is a single statement, which SQLite undoes on its own,
+// and the ops around it are still committed. When BEGIN or COMMIT keeps failing, the whole batch is
+// lost. Either way the UI already shows what failed, so writer_main() tells it to reload the list.
+size_t writer_commit_batch(write_op_t *batch, int n) {
+    for (int attempt = 1;; attempt++) {
+        size_t failures = 0;
+        int result = sqlite3_exec(WRITER_DB, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+        if (result == SQLITE_OK) {
+            for (int i = 0; i < n; i++) {
+                failures += write_op_apply(&batch[i]) != 0;
+            }
+            result = sqlite3_exec(WRITER_DB, "COMMIT;", NULL, NULL, NULL);
+            if (result == SQLITE_OK) {
+                return failures;
+            }
+            sqlite3_exec(WRITER_DB, "ROLLBACK;", NULL, NULL, NULL);
+        }
+        if ((result != SQLITE_BUSY && result != SQLITE_LOCKED) || attempt == WRITER_MAX_ATTEMPTS) {
+            fprintf(stderr, "[error] writer_commit: %s\n", sqlite3_errstr(result));
+            return n;
+        }
+        usleep(WRITER_RETRY_MS * attempt * 1000);
+    }
+}
+
+void *writer_main(void *arg) {
+    (void)arg;
+    write_op_t *batch = writer.batch;
+    pthread_mutex_lock(&writer.mutex);
+    while (1) {
+        while (writer.count == 0 && !writer.stopping && !writer.archive_pending && !writer.want_ids &&
+               !writer.check_changes) {
+            pthread_cond_wait(&writer.wake, &writer.mutex);
+        }
+        if (writer.check_changes) {
+            writer.check_changes = 0;
+            pthread_mutex_unlock(&writer.mutex);
+            writer_poll_data_version();
+            pthread_mutex_lock(&writer.mutex);
+            continue;
+        }
+        if (writer.want_ids) {
+            writer.want_ids = 0;
+            pthread_mutex_unlock(&writer.mutex);
+            sqlite3_int64 first = 0;
+            int result = SQLITE_BUSY;
+            for (int attempt = 1; result == SQLITE_BUSY && attempt <= WRITER_MAX_ATTEMPTS; attempt++) {
+                if (attempt > 1) {
+                    usleep(WRITER_RETRY_MS * attempt * 1000);
+                }
+                result = reserve_entry_ids(WRITER_DB, ENTRY_ID_BLOCK, &first);
+            }
+            if (result == SQLITE_BUSY) {
+                fprintf(stderr, "[error] writer_reserve_entry_ids: %s\n", sqlite3_errstr(result));
+            }
+            int failed = result != 0;
+            pthread_mutex_lock(&writer.mutex);
+            writer.spare_ids = failed ? 0 : first;
+            writer.ids_failed = failed;
+            pthread_cond_broadcast(&writer.idle);
+            continue;
+        }
+        if (writer.count == 0 && writer.stopping) {
+            break;
+        }
+        if (writer.count == 0) {
+            // Nothing queued: archive one batch, then look at the queue again
+            sqlite3_int64 archive_before = writer.archive_before;
+            pthread_mutex_unlock(&writer.mutex);
+            int moved = archive_entries(WRITER_DB, archive_before);
+            if (moved > 0 && moved < ARCHIVE_BATCH_ROWS) {
+                archive_compact(WRITER_DB);
+            }
+            pthread_mutex_lock(&writer.mutex);
+            writer.archive_pending = moved == ARCHIVE_BATCH_ROWS;
+            continue;
+        }
+        // Group commit: give the UI a moment to queue more ops before committing
+        struct timespec deadline;
+        writer_deadline(&deadline);
+        while (!writer.stopping && !writer.flush && writer.count < WRITER_QUEUE_CAP) {
+            if (pthread_cond_timedwait(&writer.wake, &writer.mutex, &deadline) != 0) {
+                break;
+            }
+        }
+        int n = writer.count;
+        for (int i = 0; i < n; i++) {
+            batch[i] = writer.ops[(writer.head + i) % WRITER_QUEUE_CAP];
+        }
+        writer.head = (writer.head + n) % WRITER_QUEUE_CAP;
+        writer.count = 0;
+        writer.in_flight = n;
+        writer.flush = 0;
+        pthread_cond_broadcast(&writer.idle);
+        pthread_mutex_unlock(&writer.mutex);
+
+        size_t failures = writer_commit_batch(batch, n);
+        int cleared = 0, rebalanced = 0;
+        for (int i = 0; i < n; i++) {
+            cleared |= batch[i].type == WRITE_CLEAR_COMPLETED;
+            rebalanced |= batch[i].type == WRITE_REBALANCE;
+        }
+        if (failures > 0) {
+            pthread_mutex_lock(&stats.mutex);
+            stats.write_failures += failures;
+            pthread_mutex_unlock(&stats.mutex);
+        }
+
+        pthread_mutex_lock(&writer.mutex);
+        // writer_pending_ops() copies the batch under the mutex until it is committed
+        for (int i = 0; i < n; i++) {
+            free(batch[i].description);
+        }
+        writer.in_flight = 0;
+        int reread = writer.stale_reads && writer.count == 0;
+        writer.stale_reads &= !reread;
+        if ((rebalanced || failures > 0 || reread) && write(writer.notify[1], "", 1) < 0 && errno != EAGAIN) {
+            fprintf(stderr, "[error] writer_notify: %s\n", strerror(errno));
+        }
+        writer.commits++;
+        writer.archive_pending |= cleared;
+        pthread_cond_broadcast(&writer.idle);
+    }
+    pthread_mutex_unlock(&writer.mutex);
+    return NULL;
+}
+
+void finalize_write_stmts(void) {
+    sqlite3_stmt **stmts[] = {&insert_entry_stmt, &update_entry_stmt, &delete_entry_stmt, &clear_completed_entries_stmt,
+                              &restore_cleared_entries_stmt, &rollover_entries_stmt, &rebalance_entries_stmt};
+    for (size_t i = 0; i < sizeof(stmts) / sizeof(stmts[0]); i++) {
+        sqlite3_finalize(*stmts[i]);
+        *stmts[i] = NULL;
+    }
+}
+
+// Opens the writer connection and starts the writer thread, which prepares the mutating statements on
+// it as they first run
+int writer_start(const char *path) {
+    int result = 0;
+    check_conn_err(WRITER_DB, sqlite3_open(path, &WRITER_DB), "sqlite3_open_writer");
+    check_conn_err(WRITER_DB, sqlite3_busy_timeout(WRITER_DB, DB_BUSY_TIMEOUT_MS), "busy_timeout_writer");
+    // open_db() left the database in WAL mode. Unlike setting that, which parses the whole schema,
+    // synchronous doesn't touch the file.
+    check_conn_err(WRITER_DB, sqlite3_exec(WRITER_DB, "PRAGMA synchronous = NORMAL;", NULL, 0, NULL),
+                   "synchronous_writer");
+    check_conn_err(WRITER_DB, sqlite3_prepare_v2(WRITER_DB, "PRAGMA data_version;", -1, &writer.data_version_stmt, 0),
+                   "prepare_data_version_stmt");
+    if (sqlite3_step(writer.data_version_stmt) == SQLITE_ROW) {
+        writer.data_version = sqlite3_column_int(writer.data_version_stmt, 0);
+    }
+    sqlite3_reset(writer.data_version_stmt);
+    if (pipe(writer.notify) != 0 || fcntl(writer.notify[0], F_SETFL, O_NONBLOCK) != 0 ||
+        fcntl(writer.notify[1], F_SETFL, O_NONBLOCK) != 0) {
+        fprintf(stderr, "[error] pipe_writer_notify: %s\n", strerror(errno));
+        return_defer(1);
+    }
+    // Archive whatever earlier sessions left cleared, and have ids ready for the first new entry
+    writer.archive_pending = 1;
+    writer.want_ids = 1;
+    if (pthread_create(&writer.thread, NULL, writer_main, NULL) != 0) {
+        fprintf(stderr, "[error] pthread_create_writer\n");
+        return_defer(1);
+    }
+    writer.running = 1;
+    return_defer(0);
+defer:
+    return result;
+}
+
+// Queues a mutation, waiting only when the queue is full. Without a writer thread it is applied
+// right away, and a client of a daemon sends it to the daemon's queue.
+int writer_push(write_op_type_t type, const entry_t *entry) {
+    if (client.fd >= 0) {
+        return client_push(type, entry);
+    }
+    write_op_t op = {.type = type};
+    if (entry != NULL) {
+        op.entry = *entry;
+    }
+    if (!writer.running) {
+        return write_op_apply(&op);
+    }
+    // The description lives in the UI's arena, which may be reset before the op is applied
+    if (entry != NULL && entry->description != NULL) {
+        op.description = strdup(entry->description);
+        if (op.description == NULL) {
+            return 1;
+        }
+        op.entry.description = op.description;
+    }
+    pthread_mutex_lock(&writer.mutex);
+    while (writer.count == WRITER_QUEUE_CAP) {
+        writer.flush = 1;
+        pthread_cond_signal(&writer.wake);
+        pthread_cond_wait(&writer.idle, &writer.mutex);
+    }
+    writer.ops[(writer.head + writer.count) % WRITER_QUEUE_CAP] = op;
+    writer.count++;
+    pthread_cond_signal(&writer.wake);
+    pthread_mutex_unlock(&writer.mutex);
+    return 0;
+}
+
+// Waits until every queued mutation is committed. The UI never waits on it for a read, except when
+// load_entries() can't bring a page up to date with the pending ops in memory; it is free when nothing
+// is pending.
+void writer_sync(void) {
+    if (!writer.running) {
+        return;
+    }
+    pthread_mutex_lock(&writer.mutex);
+    while (writer.count > 0 || writer.in_flight > 0) {
+        writer.flush = 1;
+        pthread_cond_signal(&writer.wake);
+        pthread_cond_wait(&writer.idle, &writer.mutex);
+    }
+    pthread_mutex_unlock(&writer.mutex);
+}
+
+// For reads that go ahead of the pending ops instead of waiting for them: search, the tags of the filter
+// view and the activity view. When ops are pending the writer notifies once they are committed, and
+// the UI reads again, see run_reload().
+void writer_read_ahead(void) {
+    if (!writer.running) {
+        return;
+    }
+    pthread_mutex_lock(&writer.mutex);
+    writer.stale_reads |= writer.count > 0 || writer.in_flight > 0;
+    pthread_mutex_unlock(&writer.mutex);
+}
+
+// Copies the ops the writer hasn't committed yet into ops, which holds 2 * WRITER_QUEUE_CAP, in the
+// order they apply: those in flight, then those queued. Their descriptions are copied into arena.
+// Returns the number of ops, or -1 when one of them changes day's list in a way only the database
+// knows: restoring a clear, rolling over to day or a later day, or rebalancing day.
+int writer_pending_ops(int day, write_op_t *ops, arena_t *arena) {
+    int n = 0;
+    if (!writer.running) {
+        return 0;
+    }
+    arena_reset(arena);
+    pthread_mutex_lock(&writer.mutex);
+    int total = writer.in_flight + writer.count;
+    for (int i = 0; i < total; i++) {
+        const write_op_t *op = i < writer.in_flight
+                                   ? &writer.batch[i]
+                                   : &writer.ops[(writer.head + i - writer.in_flight) % WRITER_QUEUE_CAP];
+        if (op->type == WRITE_RESTORE_CLEARED || (op->type == WRITE_ROLLOVER && op->entry.day >= day) ||
+            (op->type == WRITE_REBALANCE && op->entry.day == day)) {
+            n = -1;
+            break;
+        }
+        if (op->type == WRITE_ROLLOVER || op->type == WRITE_REBALANCE) {
+            continue;
+        }
+        ops[n] = *op;
+        ops[n].description = NULL;
+        if (op->entry.description != NULL) {
+            ops[n].entry.description = arena_strndup(arena, op->entry.description, strlen(op->entry.description));
+            if (ops[n].entry.description == NULL) {
+                n = -1;
+                break;
+            }
+        }
+        n++;
+    }
+    pthread_mutex_unlock(&writer.mutex);
+    return n;
+}
+
+// Commits whatever is still queued, then stops the writer thread. writer_start() may start it again.
+void writer_stop(void) {
+    if (writer.running) {
+        pthread_mutex_lock(&writer.mutex);
+        writer.stopping = 1;
+        pthread_cond_signal(&writer.wake);
+        pthread_mutex_unlock(&writer.mutex);
+        pthread_join(writer.thread, NULL);
+        writer.running = 0;
+        writer.stopping = 0;
+    }
+    sqlite3_finalize(writer.data_version_stmt);
+    writer.data_version_stmt = NULL;
+    for (int i = 0; i < 2; i++) {
+        if (writer.notify[i] >= 0) {
+            close(writer.notify[i]);
+            writer.notify[i] = -1;
+        }
+    }
+}
+
+// How often the UI and the daemon have the writer look for commits of other processes
+#define EXTERNAL_CHANGE_POLL_MS 500
+
+// Has the writer thread look for commits made by other processes. When it finds one it writes a byte
+// to writer.notify[1].
+void writer_check_changes(void) {
+    if (!writer.running) {
+        return;
+    }
+    pthread_mutex_lock(&writer.mutex);
+    writer.check_changes = 1;
+    pthread_cond_signal(&writer.wake);
+    pthread_mutex_unlock(&writer.mutex);
+}
+
+// Keeps the entries cleared at or after cleared_at out of the archive, 0 lets every cleared entry go.
+// Entries that are let go are archived once the writer is idle.
+void writer_hold_archive(sqlite3_int64 cleared_at) {
+    if (client.fd >= 0) {
+        client_hold_archive(cleared_at);
+        return;
+    }
+    sqlite3_int64 before = cleared_at != 0 ? cleared_at : LLONG_MAX;
+    pthread_mutex_lock(&writer.mutex);
+    if (before > writer.archive_before && writer.running) {
+        writer.archive_pending = 1;
+        pthread_cond_signal(&writer.wake);
+    }
+    writer.archive_before = before;
+    pthread_mutex_unlock(&writer.mutex);
+}
+
+// Returns an unused entry id, or 0 when none could be reserved. With the writer running, ids come
+// in blocks of ENTRY_ID_BLOCK that the writer thread reserves one block ahead, so adding an entry
+// doesn't wait on the database even while another instance holds the write lock. Without a writer
+// each id is reserved on its own, and a client of a daemon gets it from the daemon.
+sqlite3_int64 new_entry_id(void) {
+    if (client.fd >= 0) {
+        return client_new_entry_id();
+    }
+    if (next_entry_id == entry_id_limit) {
+        sqlite3_int64 first = 0;
+        int n = writer.running ? ENTRY_ID_BLOCK : 1;
+        if (!writer.running) {
+            int result = reserve_entry_ids(WRITER_DB, n, &first);
+            if (result == SQLITE_BUSY) {
+                fprintf(stderr, "[error] reserve_entry_ids: %s\n", sqlite3_errstr(result));
+            }
+            if (result != 0) {
+                return 0;
+            }
+        } else {
+            pthread_mutex_lock(&writer.mutex);
+            if (writer.spare_ids == 0 && writer.ids_failed && !writer.want_ids) {
+                writer.want_ids = 1;
+                pthread_cond_signal(&writer.wake);
+            }
+            while (writer.spare_ids == 0 && (writer.want_ids || !writer.ids_failed)) {
+                pthread_cond_wait(&writer.idle, &writer.mutex);
+            }
+            first = writer.spare_ids;
+            writer.spare_ids = 0;
+            writer.want_ids = first != 0;
+            pthread_cond_signal(&writer.wake);
+            pthread_mutex_unlock(&writer.mutex);
+            if (first == 0) {
+                return 0;
+            }
+        }
+        next_entry_id = first;
+        entry_id_limit = first + n;
+    }
+    return next_entry_id++;
+}
+
+// Loads what load_entries() does from the committed rows only
+int load_committed_entries(int day, const filter_t *filter, const entry_t *from, int direction, entry_t *entries,
+                           int max, int *entries_sz, arena_t *arena) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    (*entries_sz) = 0;
+    int filtered = filter_active(filter);
+    int tagged = filtered && filter->tags_sz > 0;
+    if (tagged && direction > 0) {
+        result = prepare_read_stmt(get_tagged_entries_after);
+        stmt = get_tagged_entries_after_stmt;
+    } else if (tagged) {
+        result = prepare_read_stmt(get_tagged_entries_before);
+        stmt = get_tagged_entries_before_stmt;
+    } else if (filtered && direction > 0) {
+        result = prepare_read_stmt(get_filtered_entries_after);
+        stmt = get_filtered_entries_after_stmt;
+    } else if (filtered) {
+        result = prepare_read_stmt(get_filtered_entries_before);
+        stmt = get_filtered_entries_before_stmt;
+    } else if (direction > 0) {
+        result = prepare_read_stmt(get_entries_after);
+        stmt = get_entries_after_stmt;
+    } else {
+        result = prepare_read_stmt(get_entries_before);
+        stmt = get_entries_before_stmt;
+    }
+    if (result != 0) {
+        return result;
+    }
+    if (filtered) {
+        sqlite3_bind_int(stmt, 5, filter->priority);
+    }
+    if (tagged) {
+        for (int i = 0; i < FILTER_MAX_TAGS; i++) {
+            if (i < filter->tags_sz) {
+                sqlite3_bind_int(stmt, 6 + i, filter->tags[i].id);
+            } else {
+                sqlite3_bind_null(stmt, 6 + i);
+            }
+        }
+    }
+    sqlite3_bind_int(stmt, 1, day);
+    if (from != NULL) {
+        sqlite3_bind_double(stmt, 2, from->position);
+        sqlite3_bind_int(stmt, 3, from->id);
+    } else {
+        sqlite3_bind_double(stmt, 2, direction > 0 ? -INFINITY : INFINITY);
+        sqlite3_bind_int(stmt, 3, 0);
+    }
+    sqlite3_bind_int(stmt, 4, max);
+    result = sqlite3_step(stmt);
+    while (result == SQLITE_ROW) {
+        entry_t *entry = &entries[(*entries_sz)++];
+        memset(entry, 0, sizeof(*entry));
+        entry->id = sqlite3_column_int(stmt, 0);
+        entry->description =
+            arena_strndup(arena, (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1));
+        if (entry->description == NULL) {
+            (*entries_sz)--;
+            fprintf(stderr, "[error] load_entries: out of memory\n");
+            return_defer(1);
+        }
+        entry->completed = sqlite3_column_int(stmt, 2);
+        entry->updated_at = sqlite3_column_int64(stmt, 3);
+        entry->position = sqlite3_column_double(stmt, 4);
+        entry->day = day;
+        result = sqlite3_step(stmt);
+    }
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_get_entries_stmt: %s\n", sqlite3_errmsg(DB));
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    sqlite3_reset(stmt);
+    return result;
+}
+
+// The list order, see get_entries_after_sql
+int entry_order_cmp(const void *a, const void *b) {
+    const entry_t *x = a, *y = b;
+    if (x->position != y->position) {
+        return x->position < y->position ? -1 : 1;
+    }
+    return (x->id > y->id) - (x->id < y->id);
+}
+
+// Applies ops, the writes the database may not have committed yet, to a page of day loaded from it the
+// way the writer will: an entry written by an op replaces its row and lands in the page if it belongs
+// there, and a clear takes the completed entries out. Every op is a plain assignment, so ops the
+// database already has change nothing. rows holds the *rows_sz entries the query returned out of limit,
+// with room for one more per op, and ends up as the first max entries in the order of direction.
+// Returns 1 when that can't be told: ops took entries out of a page the query cut short at limit.
+int page_apply_pending(int day, const filter_t *filter, const entry_t *from, int direction, const write_op_t *ops,
+                       int ops_sz, entry_t *rows, int *rows_sz, int limit, int max, arena_t *arena) {
+    int full = *rows_sz == limit;
+    entry_t last = full ? rows[*rows_sz - 1] : (entry_t){0};
+    for (int i = 0; i < ops_sz; i++) {
+        const entry_t *e = &ops[i].entry;
+        for (int j = *rows_sz - 1; j >= 0; j--) {
+            if (ops[i].type == WRITE_CLEAR_COMPLETED ? rows[j].completed : rows[j].id == e->id) {
+                rows[j] = rows[--(*rows_sz)];
+            }
+        }
+        if ((ops[i].type != WRITE_INSERT && ops[i].type != WRITE_UPDATE) || e->day != day || e->ignored != 0 ||
+            !filter_matches(filter, e) || (from != NULL && entry_order_cmp(e, from) * direction <= 0) ||
+            (full && entry_order_cmp(e, &last) * direction > 0)) {
+            continue;
+        }
+        entry_t *row = &rows[(*rows_sz)++];
+        *row = *e;
+        row->description = arena_strndup(arena, e->description, strlen(e->description));
+        if (row->description == NULL) {
+            return 1;
+        }
+    }
+    qsort(rows, *rows_sz, sizeof(entry_t), entry_order_cmp);
+    for (int i = 0, j = *rows_sz - 1; direction < 0 && i < j; i++, j--) {
+        entry_t t = rows[i];
+        rows[i] = rows[j];
+        rows[j] = t;
+    }
+    if (full && *rows_sz < max) {
+        return 1;
+    }
+    *rows_sz = *rows_sz < max ? *rows_sz : max;
+    return 0;
+}
+
+// Loads up to max entries of day that come after (direction > 0) or before (direction < 0) the entry
+// from in the list order, nearest first, leaving out those filter doesn't match. A NULL from starts at
+// the beginning or the end of the list. The descriptions are copied into arena.
+//
+// The page is read without waiting for the writer, and the ops it hasn't committed yet are applied to
+// it, see page_apply_pending(). It only waits for them when they restore a clear, roll over or
+// rebalance the day, or take out entries a cut short page needs.
+int load_entries(int day, const filter_t *filter, const entry_t *from, int direction, entry_t *entries, int max,
+                 int *entries_sz, arena_t *arena) {
+    static write_op_t pending[2 * WRITER_QUEUE_CAP];
+    static arena_t pending_arena = {0};
+    (*entries_sz) = 0;
+    if (client.fd >= 0) {
+        return client_load_entries(day, filter, from, direction, entries, max, entries_sz, arena);
+    }
+    int pending_sz = writer_pending_ops(day, pending, &pending_arena);
+    if (pending_sz > 0) {
+        // Every op may take one row out of the page and put one in
+        int limit = max + pending_sz, rows_sz = 0;
+        entry_t *rows = malloc(sizeof(entry_t) * (limit + pending_sz));
+        int result = 1;
+        if (rows != NULL) {
+            result = load_committed_entries(day, filter, from, direction, rows, limit, &rows_sz, arena);
+        }
+        int stale = result == 0 && page_apply_pending(day, filter, from, direction, pending, pending_sz, rows, &rows_sz,
+                                                      limit, max, arena) != 0;
+        if (result == 0 && !stale) {
+            memcpy(entries, rows, sizeof(entry_t) * rows_sz);
+            (*entries_sz) = rows_sz;
+        }
+        free(rows);
+        if (!stale) {
+            return result;
+        }
+    }
+    if (pending_sz != 0) {
+        writer_sync();
+    }
+    return load_committed_entries(day, filter, from, direction, entries, max, entries_sz, arena);
+}
+
+// List view
+//
+// Only a window of the result set is kept in memory: the visible rows plus LIST_PREFETCH_ROWS on
+// either side. Moving the cursor close to an edge of the window loads the next page and drops rows
+// from the opposite edge, so scrolling costs the same regardless of the table size.
+
+typedef struct List {
+    entry_t *entries; // loaded window, in list order
+    int entries_sz;
+    int entries_cap;
+    int at_start; // the window starts at the first entry of the list
+    int at_end;   // the window ends at the last entry of the list
+    int top;      // index of the first visible entry
+    int cursor;   // index of the selected entry
+    int height;   // number of visible entries
+    int day;      // the day whose tasks are listed
+    int rebalancing; // a rebalance of day is queued: the loaded positions are stale until the next load
+    filter_t filter; // only entries it matches are listed
+    arena_t arena; // descriptions of the loaded entries, and of entries dropped since the last collection
+} list_t;
+
+int list_init(list_t *list, int height) {
+    memset(list, 0, sizeof(*list));
+    list->height = height;
+    list->day = today();
+    list->entries_cap = height + 3 * LIST_PREFETCH_ROWS;
+    list->entries = malloc(sizeof(entry_t) * list->entries_cap);
+    return list->entries == NULL;
+}
+
+void list_free(list_t *list) {
+    free(list->entries);
+    arena_free(&list->arena);
+}
+
+entry_t *list_selected(list_t *list) { return list->entries_sz > 0 ? &list->entries[list->cursor] : NULL; }
+
+void list_scroll_to_cursor(list_t *list) {
+    if (list->cursor >= list->entries_sz) {
+        list->cursor = list->entries_sz - 1;
+    }
+    if (list->cursor < 0) {
+        list->cursor = 0;
+    }
+    if (list->cursor < list->top) {
+        list->top = list->cursor;
+    }
+    if (list->cursor >= list->top + list->height) {
+        list->top = list->cursor - list->height + 1;
+    }
+    if (list->top > list->entries_sz - list->height && list->at_end) {
+        list->top = list->entries_sz - list->height;
+    }
+    if (list->top < 0) {
+        list->top = 0;
+    }
+}
+
+// Copies the descriptions of the loaded window into a fresh arena once the entries dropped from it
+// take up most of the current one
+int list_collect(list_t *list) {
+    if (list->arena.used < LIST_ARENA_COLLECT_BYTES) {
+        return 0;
+    }
+    size_t live = 0;
+    for (int i = 0; i < list->entries_sz; i++) {
+        live += strlen(list->entries[i].description) + 1;
+    }
+    if (list->arena.used < 2 * live) {
+        return 0;
+    }
+    arena_t arena = {0};
+    char *p = arena_alloc(&arena, live > 0 ? live : 1);
+    if (p == NULL) {
+        return 1;
+    }
+    for (int i = 0; i < list->entries_sz; i++) {
+        size_t len = strlen(list->entries[i].description) + 1;
+        memcpy(p, list->entries[i].description, len);
+        list->entries[i].description = p;
+        p += len;
+    }
+    arena_free(&list->arena);
+    list->arena = arena;
+    return 0;
+}
+
+int list_load_first(list_t *list) {
+    int want = list->height + LIST_PREFETCH_ROWS;
+    arena_reset(&list->arena);
+    list->rebalancing = 0;
+    int result =
+        load_entries(list->day, &list->filter, NULL, 1, list->entries, want, &list->entries_sz, &list->arena);
+    list->at_start = 1;
+    list->at_end = list->entries_sz < want;
+    list->top = 0;
+    list->cursor = 0;
+    return result;
+}
+
+void reverse_entries(entry_t *entries, int n) {
+    for (int i = 0; i < n / 2; i++) {
+        entry_t tmp = entries[i];
+        entries[i] = entries[n - 1 - i];
+        entries[n - 1 - i] = tmp;
+    }
+}
+
+int list_load_last(list_t *list) {
+    int want = list->height + LIST_PREFETCH_ROWS;
+    arena_reset(&list->arena);
+    list->rebalancing = 0;
+    int result =
+        load_entries(list->day, &list->filter, NULL, -1, list->entries, want, &list->entries_sz, &list->arena);
+    reverse_entries(list->entries, list->entries_sz);
+    list->at_start = list->entries_sz < want;
+    list->at_end = 1;
+    list->cursor = list->entries_sz - 1;
+    list->top = 0;
+    list_scroll_to_cursor(list);
+    return result;
+}
+
+// Appends up to n entries after the window, dropping entries from its start to stay within capacity
+int list_fetch_after(list_t *list, int n) {
+    if (list->entries_sz + n > list->entries_cap) {
+        int drop = list->entries_sz + n - list->entries_cap;
+        if (drop > list->top) {
+            drop = list->top;
+        }
+        memmove(list->entries, list->entries + drop, sizeof(entry_t) * (list->entries_sz - drop));
+        list->entries_sz -= drop;
+        list->top -= drop;
+        list->cursor -= drop;
+        list->at_start = list->at_start && drop == 0;
+        if (list->entries_sz + n > list->entries_cap) {
+            n = list->entries_cap - list->entries_sz;
+        }
+    }
+    int loaded = 0;
+    const entry_t *from = list->entries_sz > 0 ? &list->entries[list->entries_sz - 1] : NULL;
+    int result =
+        load_entries(list->day, &list->filter, from, 1, list->entries + list->entries_sz, n, &loaded, &list->arena);
+    list->entries_sz += loaded;
+    list->at_end = loaded < n;
+    return result || list_collect(list);
+}
+
+// Prepends up to n entries before the window, dropping entries from its end to stay within capacity
+int list_fetch_before(list_t *list, int n) {
+    if (list->entries_sz + n > list->entries_cap) {
+        int drop = list->entries_sz + n - list->entries_cap;
+        int visible_end = list->top + list->height;
+        if (drop > list->entries_sz - visible_end) {
+            drop = list->entries_sz - visible_end > 0 ? list->entries_sz - visible_end : 0;
+        }
+        list->entries_sz -= drop;
+        list->at_end = list->at_end && drop == 0;
+        if (list->entries_sz + n > list->entries_cap) {
+            n = list->entries_cap - list->entries_sz;
+        }
+    }
+    entry_t *fetched = malloc(sizeof(entry_t) * (n > 0 ? n : 1));
+    if (fetched == NULL) {
+        return 1;
+    }
+    int loaded = 0;
+    const entry_t *from = list->entries_sz > 0 ? &list->entries[0] : NULL;
+    int result = load_entries(list->day, &list->filter, from, -1, fetched, n, &loaded, &list->arena);
+    reverse_entries(fetched, loaded);
+    memmove(list->entries + loaded, list->entries, sizeof(entry_t) * list->entries_sz);
+    memcpy(list->entries, fetched, sizeof(entry_t) * loaded);
+    free(fetched);
+    list->entries_sz += loaded;
+    list->top += loaded;
+    list->cursor += loaded;
+    list->at_start = loaded < n;
+    return result || list_collect(list);
+}
+
+// Loads the window around anchor: the anchor and what follows it become visible from the top of the
+// viewport, with the cursor row rows below it. Only the anchor's sort key is used, its description
+// may live in the arena that gets reset.
+int list_load_around(list_t *list, entry_t anchor, int row) {
+    int result = 0;
+    int loaded = 0;
+    arena_reset(&list->arena);
+    list->rebalancing = 0;
+    result = load_entries(list->day, &list->filter, &anchor, -1, list->entries, LIST_PREFETCH_ROWS, &loaded,
+                          &list->arena);
+    reverse_entries(list->entries, loaded);
+    list->at_start = loaded < LIST_PREFETCH_ROWS;
+    list->top = loaded;
+    list->entries_sz = loaded;
+
+    // Include the anchor itself: ids are integers, so the next id down bounds it inclusively
+    anchor.id -= 1;
+    int want = list->height + LIST_PREFETCH_ROWS;
+    if (result == 0) {
+        result = load_entries(list->day, &list->filter, &anchor, 1, list->entries + list->entries_sz, want, &loaded,
+                              &list->arena);
+        list->entries_sz += loaded;
+        list->at_end = loaded < want;
+    }
+    list->cursor = list->top + row;
+    list_scroll_to_cursor(list);
+    return result;
+}
+
+// Reloads the window around the first visible entry, keeping the cursor on the same screen row
+int list_reload(list_t *list) {
+    if (list->entries_sz == 0 || list->at_start) {
+        int cursor = list->cursor;
+        int result = list_load_first(list);
+        list->cursor = cursor;
+        list_scroll_to_cursor(list);
+        return result;
+    }
+    return list_load_around(list, list->entries[list->top], list->cursor - list->top);
+}
+
+// Loads the part of the list that contains entry and selects it
+int list_focus(list_t *list, const entry_t *entry) {
+    list->day = entry->day;
+    return list_load_around(list, *entry, 0);
+}
+
+// Lists the tasks of another day, from the top
+int list_show_day(list_t *list, int day) {
+    list->day = day;
+    return list_load_first(list);
+}
+
+// Lists only the entries filter matches, from the top
+int list_set_filter(list_t *list, const filter_t *filter) {
+    list->filter = *filter;
+    return list_load_first(list);
+}
+
+// Moves the cursor one entry up (delta < 0) or down (delta > 0), wrapping around at either end
+void list_move(list_t *list, int delta) {
+    if (list->entries_sz == 0) {
+        return;
+    }
+    if (delta > 0) {
+        if (list->cursor + 1 + LIST_PREFETCH_ROWS >= list->entries_sz && !list->at_end) {
+            list_fetch_after(list, LIST_PREFETCH_ROWS);
+        }
+        if (list->cursor + 1 >= list->entries_sz) {
+            if (list->at_start) {
+                list->cursor = 0;
+                list->top = 0;
+            } else {
+                list_load_first(list);
+            }
+            return;
+        }
+        list->cursor++;
+    } else {
+        if (list->cursor - 1 - LIST_PREFETCH_ROWS < 0 && !list->at_start) {
+            list_fetch_before(list, LIST_PREFETCH_ROWS);
+        }
+        if (list->cursor == 0) {
+            if (list->at_end) {
+                list->cursor = list->entries_sz - 1;
+            } else {
+                list_load_last(list);
+            }
+        } else {
+            list->cursor--;
+        }
+    }
+    list_scroll_to_cursor(list);
+}
+
+// Undo history
+//
+// The changes made in the list view are kept in a ring buffer of the last UNDO_HISTORY operations, each
+// with the entry as it was before and after it. Undo writes the before image back and redo the after
+// one, through the writer like any other change. A clear only records its time: the entries it cleared
+// carry it in ignored, and stay out of the archive while the clear can be undone.
+
+#define UNDO_HISTORY 64
+
+typedef enum UndoOpType { UNDO_INSERT, UNDO_UPDATE, UNDO_DELETE, UNDO_CLEAR } undo_op_type_t;
+
+typedef struct UndoOp {
+    undo_op_type_t type;
+    entry_t before; // unused for UNDO_INSERT and UNDO_CLEAR
+    entry_t after;  // unused for UNDO_DELETE, only updated_at, the time of the clear, for UNDO_CLEAR
+} undo_op_t;
+
+typedef struct History {
+    undo_op_t ops[UNDO_HISTORY]; // the descriptions are owned by the history
+    int head;                    // oldest op
+    int count;
+    int done; // ops [0, done) can be undone, ops [done, count) redone
+} history_t;
+
+history_t history = {0};
+
+undo_op_t *history_at(int i) { return &history.ops[(history.head + i) % UNDO_HISTORY]; }
+
+void undo_op_free(undo_op_t *op) {
+    free((char *)op->before.description);
+    free((char *)op->after.description);
+    memset(op, 0, sizeof(*op));
+}
+
+// Copies src into dst with its own copy of the description
+int undo_entry_copy(entry_t *dst, const entry_t *src) {
+    *dst = *src;
+    if (src->description != NULL) {
+        dst->description = strdup(src->description);
+        if (dst->description == NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Holds back the archiving of the oldest clear that can still be undone, and of every later one
+void history_hold_archive(void) {
+    sqlite3_int64 oldest = 0;
+    for (int i = 0; i < history.done && oldest == 0; i++) {
+        if (history_at(i)->type == UNDO_CLEAR) {
+            oldest = history_at(i)->after.updated_at;
+        }
+    }
+    writer_hold_archive(oldest);
+}
+
+// Records a change, dropping the changes that were undone and, once the history is full, the oldest one
+int history_record(undo_op_type_t type, const entry_t *before, const entry_t *after) {
+    while (history.count > history.done) {
+        undo_op_free(history_at(--history.count));
+    }
+    if (history.count == UNDO_HISTORY) {
+        undo_op_free(history_at(0));
+        history.head = (history.head + 1) % UNDO_HISTORY;
+        history.count--;
+        history.done--;
+    }
+    undo_op_t *op = history_at(history.count);
+    op->type = type;
+    if ((before != NULL && undo_entry_copy(&op->before, before) != 0) ||
+        (after != NULL && undo_entry_copy(&op->after, after) != 0)) {
+        undo_op_free(op);
+        return 1;
+    }
+    history.count++;
+    history.done++;
+    history_hold_archive();
+    return 0;
+}
+
+void history_free(void) {
+    for (int i = 0; i < history.count; i++) {
+        undo_op_free(history_at(i));
+    }
+    memset(&history, 0, sizeof(history));
+    history_hold_archive();
+}
+
+// Model
+//
+// Mutations are applied to the loaded window first, moving only the affected entry to its new place
+// in the list order, and then persisted. The list is only reloaded from the database at startup, when
+// another process changed it, and by the changes that touch entries all over it.
+
+// New entries go POSITION_STEP after the last entry of their day. A move that leaves less than
+// POSITION_MIN_GAP between two positions has the writer rebalance the day, see rebalance_entries_sql.
+#define POSITION_STEP 1024.0
+#define POSITION_MIN_GAP 1e-6
+
+// Position for an entry put between before and after, either of which is NULL at an end of the list
+double position_between(const entry_t *before, const entry_t *after) {
+    if (before == NULL && after == NULL) {
+        return POSITION_STEP;
+    }
+    if (before == NULL) {
+        return after->position - POSITION_STEP;
+    }
+    if (after == NULL) {
+        return before->position + POSITION_STEP;
+    }
+    return before->position + (after->position - before->position) / 2;
+}
+
+// Whether position is too close to before or after to split the gap again
+int position_crowded(double position, const entry_t *before, const entry_t *after) {
+    return (before != NULL && position - before->position < POSITION_MIN_GAP) ||
+           (after != NULL && after->position - position < POSITION_MIN_GAP);
+}
+
+// Compares two entries in list order, see get_entries_after_sql
+int entry_cmp(const entry_t *a, const entry_t *b) {
+    if (a->position != b->position)
+        return a->position < b->position ? -1 : 1;
+    if (a->id != b->id)
+        return a->id < b->id ? -1 : 1;
+    return 0;
+}
+
+void list_remove(list_t *list, int index) {
+    memmove(list->entries + index, list->entries + index + 1, sizeof(entry_t) * (list->entries_sz - index - 1));
+    list->entries_sz--;
+}
+
+// Inserts entry at its place in the window. Entries that sort before or after the loaded window are
+// left out, they are picked up when that part of the list gets loaded, and so are entries the filter
+// doesn't match.
+void list_insert(list_t *list, const entry_t *entry) {
+    if (!filter_matches(&list->filter, entry)) {
+        return;
+    }
+    int lo = 0, hi = list->entries_sz;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (entry_cmp(&list->entries[mid], entry) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if ((lo == 0 && !list->at_start && list->entries_sz > 0) || (lo == list->entries_sz && !list->at_end)) {
+        return;
+    }
+    if (list->entries_sz == list->entries_cap) {
+        if (lo == list->entries_sz) {
+            return;
+        }
+        list->entries_sz--;
+        list->at_end = 0;
+    }
+    memmove(list->entries + lo + 1, list->entries + lo, sizeof(entry_t) * (list->entries_sz - lo));
+    list->entries[lo] = *entry;
+    list->entries_sz++;
+}
+
+// Tops the window back up after entries were taken out of it
+int list_fill(list_t *list) {
+    int result = 0;
+    int want = list->top + list->height + LIST_PREFETCH_ROWS;
+    if (list->entries_sz < want && !list->at_end) {
+        result = list_fetch_after(list, want - list->entries_sz);
+    }
+    list_scroll_to_cursor(list);
+    return result || list_collect(list);
+}
+
+// Changes the number of visible entries, loading more of the list if the window no longer covers it
+int list_set_height(list_t *list, int height) {
+    int cap = height + 3 * LIST_PREFETCH_ROWS;
+    if (cap > list->entries_cap) {
+        entry_t *entries = realloc(list->entries, sizeof(entry_t) * cap);
+        if (entries == NULL) {
+            return 1;
+        }
+        list->entries = entries;
+        list->entries_cap = cap;
+    }
+    list->height = height;
+    return list_fill(list);
+}
+
+// Moves the entry at index to its new place after its sort key changed
+int list_reposition(list_t *list, int index) {
+    entry_t entry = list->entries[index];
+    list_remove(list, index);
+    list_insert(list, &entry);
+    return list_fill(list);
+}
+
+int list_toggle_selected(list_t *list) {
+    entry_t *entry = list_selected(list);
+    if (entry == NULL) {
+        return 0;
+    }
+    entry_t before = *entry;
+    entry->completed = entry->completed ? 0 : 1;
+    entry->updated_at = time(NULL);
+    history_record(UNDO_UPDATE, &before, entry);
+    return writer_push(WRITE_UPDATE, entry);
+}
+
+int list_edit_selected(list_t *list, const char *description, int len) {
+    entry_t *entry = list_selected(list);
+    if (entry == NULL) {
+        return 0;
+    }
+    const char *copy = arena_strndup(&list->arena, description, len);
+    if (copy == NULL) {
+        return 1;
+    }
+    entry_t before = *entry;
+    entry->description = copy;
+    entry->updated_at = time(NULL);
+    history_record(UNDO_UPDATE, &before, entry);
+    int result = writer_push(WRITE_UPDATE, entry);
+    // An edit can take away a tag or the priority the list is filtered on
+    if (!filter_matches(&list->filter, entry)) {
+        list_remove(list, list->cursor);
+        result |= list_fill(list);
+    }
+    return result;
+}
+
+// Gives the selected entry priority by rewriting the priority words of its description, see the Tags
+// section, so it is undone like any other edit
+int list_set_priority_selected(list_t *list, int priority) {
+    entry_t *entry = list_selected(list);
+    if (entry == NULL) {
+        return 0;
+    }
+    char *description = malloc(strlen(entry->description) + PRIORITY_MAX + 2);
+    if (description == NULL) {
+        return 1;
+    }
+    description_set_priority(entry->description, priority, description);
+    int result = list_edit_selected(list, description, strlen(description));
+    free(description);
+    return result;
+}
+
+int list_delete_selected(list_t *list) {
+    entry_t *entry = list_selected(list);
+    if (entry == NULL) {
+        return 0;
+    }
+    history_record(UNDO_DELETE, entry, NULL);
+    int result = writer_push(WRITE_DELETE, entry);
+    list_remove(list, list->cursor);
+    list->cursor -= 1;
+    list_fill(list);
+    return result;
+}
+
+// Index of the entry with id in the loaded window, -1 if it isn't loaded
+int list_find(const list_t *list, int id) {
+    for (int i = 0; i < list->entries_sz; i++) {
+        if (list->entries[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Shows entry as given and selects it, in place of the loaded copy if there is one. The list is
+// loaded around it when it belongs to another day or to a part of the list that isn't loaded.
+int list_put(list_t *list, const entry_t *entry) {
+    int index = list_find(list, entry->id);
+    if (index >= 0) {
+        list_remove(list, index);
+    }
+    if (entry->day == list->day) {
+        entry_t copy = *entry;
+        copy.description = arena_strndup(&list->arena, entry->description, strlen(entry->description));
+        if (copy.description == NULL) {
+            return 1;
+        }
+        list_insert(list, &copy);
+        index = list_find(list, entry->id);
+        if (index >= 0) {
+            list->cursor = index;
+            return list_fill(list);
+        }
+    }
+    return list_focus(list, entry);
+}
+
+// Adds an entry at the end of the day and selects it
+int list_add(list_t *list, const char *description, int len) {
+    entry_t entry = {0};
+    entry.id = new_entry_id();
+    entry.day = list->day;
+    entry.description = arena_strndup(&list->arena, description, len);
+    if (entry.id == 0 || entry.description == NULL) {
+        return 1;
+    }
+    entry_t last;
+    int found = 0;
+    // The last loaded entry is the last of the day unless the filter hides the ones after it
+    int filtered = filter_active(&list->filter);
+    if (list->at_end && !filtered && list->entries_sz > 0) {
+        last = list->entries[list->entries_sz - 1];
+        found = 1;
+    } else if ((!list->at_end || filtered) &&
+               load_entries(list->day, NULL, NULL, -1, &last, 1, &found, &list->arena) != 0) {
+        return 1;
+    }
+    entry.position = position_between(found ? &last : NULL, NULL);
+    history_record(UNDO_INSERT, NULL, &entry);
+    int result = writer_push(WRITE_INSERT, &entry);
+    return result || list_put(list, &entry);
+}
+
+// Moves the selected entry one place up (delta < 0) or down (delta > 0): it gets a position between
+// its new neighbours, and only its row is written. When the gap gets too small to split again, the
+// writer rebalances the day in the background and the list is reloaded once it is done. The positions
+// loaded until then are stale: the next move reloads first, and the history starts over.
+int list_move_selected(list_t *list, int delta) {
+    if (list->rebalancing && list_reload(list) != 0) {
+        return 1;
+    }
+    if (list->entries_sz == 0) {
+        return 0;
+    }
+    // Load the neighbours on that side
+    if (delta < 0 && list->cursor < 2 && !list->at_start) {
+        list_fetch_before(list, LIST_PREFETCH_ROWS);
+    } else if (delta > 0 && list->cursor + 2 >= list->entries_sz && !list->at_end) {
+        list_fetch_after(list, LIST_PREFETCH_ROWS);
+    }
+    int cursor = list->cursor;
+    const entry_t *before, *after;
+    if (delta < 0) {
+        if (cursor == 0) {
+            return 0;
+        }
+        before = cursor >= 2 ? &list->entries[cursor - 2] : NULL;
+        after = &list->entries[cursor - 1];
+    } else {
+        if (cursor + 1 >= list->entries_sz) {
+            return 0;
+        }
+        before = &list->entries[cursor + 1];
+        after = cursor + 2 < list->entries_sz ? &list->entries[cursor + 2] : NULL;
+    }
+    entry_t *entry = &list->entries[cursor];
+    entry_t moved = *entry;
+    moved.position = position_between(before, after);
+    int crowded = position_crowded(moved.position, before, after);
+    history_record(UNDO_UPDATE, entry, &moved);
+    int result = writer_push(WRITE_UPDATE, &moved);
+    *entry = moved;
+    result |= list_reposition(list, cursor);
+    int index = list_find(list, moved.id);
+    if (index >= 0) {
+        list->cursor = index;
+        list_scroll_to_cursor(list);
+    }
+    if (crowded) {
+        entry_t rebalance = {.day = list->day};
+        result |= writer_push(WRITE_REBALANCE, &rebalance);
+        list->rebalancing = 1;
+        history_free();
+    }
+    return result;
+}
+
+// Moves the unfinished tasks of earlier days to today. The list is reloaded, as the shown day either
+// gains or loses tasks unless it is a later one. Rolling over can't be undone, and the entries it moves
+// would be put back on their old day by undoing earlier changes, so the history starts over.
+int list_rollover(list_t *list) {
+    entry_t entry = {.day = today()};
+    int result = writer_push(WRITE_ROLLOVER, &entry);
+    history_free();
+    return result || list_reload(list);
+}
+
+// Takes the completed entries out of the loaded window
+int list_drop_completed(list_t *list) {
+    int kept = 0;
+    for (int i = 0; i < list->entries_sz; i++) {
+        if (list->entries[i].completed) {
+            if (i < list->top) {
+                list->top--;
+            }
+            if (i < list->cursor) {
+                list->cursor--;
+            }
+        } else {
+            list->entries[kept++] = list->entries[i];
+        }
+    }
+    list->entries_sz = kept;
+    return list_fill(list);
+}
+
+// Time of a new clear, never the same as the one of an earlier clear, see migrate_cleared_at_v7_sql
+sqlite3_int64 next_clear_time(void) {
+    static sqlite3_int64 last = 0;
+    sqlite3_int64 now = time(NULL);
+    last = now > last ? now : last + 1;
+    return last;
+}
+
+// The history is recorded first: it keeps the cleared entries out of the archive before the writer
+// can get to them
+int list_clear_completed(list_t *list) {
+    entry_t clear = {.updated_at = next_clear_time()};
+    history_record(UNDO_CLEAR, NULL, &clear);
+    int result = writer_push(WRITE_CLEAR_COMPLETED, &clear);
+    list_drop_completed(list);
+    return result;
+}
+
+// Takes the entry with id out of the loaded window, keeping the cursor on the entry it was on
+int list_forget(list_t *list, int id) {
+    int index = list_find(list, id);
+    if (index < 0) {
+        return 0;
+    }
+    list_remove(list, index);
+    if (index < list->cursor) {
+        list->cursor--;
+    }
+    return list_fill(list);
+}
+
+// Reverts the last change that is not undone yet. Only undoing a clear reloads the list, as the
+// entries it brings back may be anywhere in it.
+int list_undo(list_t *list) {
+    if (history.done == 0) {
+        return 0;
+    }
+    undo_op_t *op = history_at(--history.done);
+    int result = 0;
+    switch (op->type) {
+    case UNDO_INSERT:
+        result = writer_push(WRITE_DELETE, &op->after);
+        result |= list_forget(list, op->after.id);
+        break;
+    case UNDO_UPDATE:
+        result = writer_push(WRITE_UPDATE, &op->before);
+        result |= list_put(list, &op->before);
+        break;
+    case UNDO_DELETE:
+        result = writer_push(WRITE_INSERT, &op->before);
+        result |= list_put(list, &op->before);
+        break;
+    case UNDO_CLEAR:
+        result = writer_push(WRITE_RESTORE_CLEARED, &op->after);
+        result |= list_reload(list);
+        break;
+    }
+    history_hold_archive();
+    return result;
+}
+
+// Applies the last undone change again
+int list_redo(list_t *list) {
+    if (history.done == history.count) {
+        return 0;
+    }
+    undo_op_t *op = history_at(history.done++);
+    history_hold_archive();
+    int result = 0;
+    switch (op->type) {
+    case UNDO_INSERT:
+        result = writer_push(WRITE_INSERT, &op->after);
+        result |= list_put(list, &op->after);
+        break;
+    case UNDO_UPDATE:
+        result = writer_push(WRITE_UPDATE, &op->after);
+        result |= list_put(list, &op->after);
+        break;
+    case UNDO_DELETE:
+        result = writer_push(WRITE_DELETE, &op->before);
+        result |= list_forget(list, op->before.id);
+        break;
+    case UNDO_CLEAR:
+        result = writer_push(WRITE_CLEAR_COMPLETED, &op->after);
+        result |= list_drop_completed(list);
+        break;
+    }
+    return result;
+}
+
+// Search
+//
+// The search view runs a prefix query against entries_fts as the user types. Queries are debounced:
+// one runs only after SEARCH_DEBOUNCE_MS without a key, as an idle task of the event loop.
+
+#define SEARCH_DEBOUNCE_MS 30
+
+typedef struct Search {
+    entry_t *results;
+    int results_sz;
+    int results_cap;
+    int cursor;
+    int dirty; // the query changed since the results were loaded
+    arena_t arena;
+} search_t;
+
+int search_init(search_t *search, int cap) {
+    memset(search, 0, sizeof(*search));
+    search->results_cap = cap;
+    search->results = malloc(sizeof(entry_t) * cap);
+    return search->results == NULL;
+}
+
+void search_free(search_t *search) {
+    free(search->results);
+    arena_free(&search->arena);
+}
+
+// Changes how many results a query returns. The current results are kept until the query runs again.
+int search_set_cap(search_t *search, int cap) {
+    if (cap > search->results_cap) {
+        entry_t *results = realloc(search->results, sizeof(entry_t) * cap);
+        if (results == NULL) {
+            return 1;
+        }
+        search->results = results;
+    }
+    if (search->results_sz > cap) {
+        search->results_sz = cap;
+    }
+    if (search->cursor >= cap) {
+        search->cursor = cap - 1;
+    }
+    search->results_cap = cap;
+    return 0;
+}
+
+// Turns what the user typed into an FTS5 query that prefix-matches every word, e.g. `wo ta` becomes
+// `"wo"* "ta"*`. Returns the number of words.
+int search_build_match(const char *input, int len, char *out, size_t cap) {
+    size_t n = 0;
+    int words = 0;
+    int i = 0;
+    while (i < len) {
+        while (i < len && (input[i] == ' ' || input[i] == '\t')) {
+            i++;
+        }
+        if (i == len) {
+            break;
+        }
+        // Room for the worst case: every byte a doubled quote, plus the quotes, star and space
+        if (n + 2 * (len - i) + 4 >= cap) {
+            break;
+        }
+        out[n++] = '"';
+        while (i < len && input[i] != ' ' && input[i] != '\t') {
+            if (input[i] == '"') {
+                out[n++] = '"';
+            }
+            out[n++] = input[i++];
+        }
+        out[n++] = '"';
+        out[n++] = '*';
+        out[n++] = ' ';
+        words++;
+    }
+    out[n] = '\0';
+    return words;
+}
+
+int search_entries(search_t *search, const char *input, int len) {
+    int result = 0;
+    search->results_sz = 0;
+    search->cursor = 0;
+    search->dirty = 0;
+    arena_reset(&search->arena);
+    if (client.fd >= 0) {
+        return client_search(input, len, search->results, search->results_cap, &search->results_sz, &search->arena);
+    }
+    // Worst case: every other byte a one byte word, quoted, starred and followed by a space
+    size_t match_cap = 6 * (size_t)len + 8;
+    char *match = malloc(match_cap);
+    if (match == NULL) {
+        return_defer(1);
+    }
+    if (search_build_match(input, len, match, match_cap) == 0) {
+        return_defer(0);
+    }
+    writer_read_ahead();
+    if (prepare_read_stmt(search_entries) != 0) {
+        return_defer(1);
+    }
+    sqlite3_bind_text(search_entries_stmt, 1, match, -1, SQLITE_STATIC);
+    sqlite3_bind_int(search_entries_stmt, 2, search->results_cap);
+    result = sqlite3_step(search_entries_stmt);
+    while (result == SQLITE_ROW) {
+        entry_t *entry = &search->results[search->results_sz++];
+        memset(entry, 0, sizeof(*entry));
+        entry->id = sqlite3_column_int(search_entries_stmt, 0);
+        entry->description = arena_strndup(&search->arena, (const char *)sqlite3_column_text(search_entries_stmt, 1),
+                                           sqlite3_column_bytes(search_entries_stmt, 1));
+        if (entry->description == NULL) {
+            search->results_sz--;
+            return_defer(1);
+        }
+        entry->completed = sqlite3_column_int(search_entries_stmt, 2);
+        entry->updated_at = sqlite3_column_int64(search_entries_stmt, 3);
+        entry->day = sqlite3_column_int(search_entries_stmt, 4);
+        entry->position = sqlite3_column_double(search_entries_stmt, 5);
+        result = sqlite3_step(search_entries_stmt);
+    }
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_search_entries_stmt: %s\n", sqlite3_errmsg(DB));
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    // Not prepared yet when the query has no words to match
+    if (search_entries_stmt != NULL) {
+        sqlite3_reset(search_entries_stmt);
+        sqlite3_clear_bindings(search_entries_stmt);
+    }
+    free(match);
+    return result;
+}
+
+// Loads the tags of the tasks that are not cleared, by name, for the filter view
+int load_tags(tag_t *tags, int max, int *tags_sz) {
+    int result = 0;
+    *tags_sz = 0;
+    if (client.fd >= 0) {
+        return client_load_tags(tags, max, tags_sz);
+    }
+    writer_read_ahead();
+    if (prepare_read_stmt(get_tags) != 0) {
+        return 1;
+    }
+    sqlite3_bind_int(get_tags_stmt, 1, max);
+    sqlite3_bind_int(get_tags_stmt, 2, TAG_NAME_SIZE);
+    result = sqlite3_step(get_tags_stmt);
+    while (result == SQLITE_ROW && *tags_sz < max) {
+        tag_t *tag = &tags[(*tags_sz)++];
+        tag->id = sqlite3_column_int(get_tags_stmt, 0);
+        snprintf(tag->name, TAG_NAME_SIZE, "%s", (const char *)sqlite3_column_text(get_tags_stmt, 1));
+        result = sqlite3_step(get_tags_stmt);
+    }
+    if (result != SQLITE_DONE && result != SQLITE_ROW) {
+        fprintf(stderr, "[error] step_get_tags_stmt: %s\n", sqlite3_errmsg(DB));
+        return_defer(result);
+    }
+    return_defer(0);
+defer:
+    sqlite3_reset(get_tags_stmt);
+    sqlite3_clear_bindings(get_tags_stmt);
+    return result;
+}
+
+// Activity
+//
+// The activity view shows how many tasks were created, completed and cleared on each of the last
+// ACTIVITY_DAYS days and in each of the last ACTIVITY_WEEKS weeks, along with the completion streaks.
+// It only reads the counters kept in daily_stats, see migrate_daily_stats_v10_sql, so it takes the same
+// time for a week of history as for years of it.
+
+// Loads the days up to end and the weeks up to the one of end, with the streaks as of today
+int load_activity(int end, int today, activity_t *activity) {
+    int result = 0;
+    memset(activity, 0, sizeof(*activity));
+    activity->end = end;
+    for (int i = 0; i < ACTIVITY_DAYS; i++) {
+        activity->days[i].day = end - ACTIVITY_DAYS + 1 + i;
+    }
+    for (int i = 0; i < ACTIVITY_WEEKS; i++) {
+        activity->weeks[i].day = week_of(end) - 7 * (ACTIVITY_WEEKS - 1 - i);
+    }
+    if (client.fd >= 0) {
+        return client_load_activity(end, today, activity);
+    }
+    writer_read_ahead();
+    if (prepare_read_stmt(activity_days) != 0 || prepare_read_stmt(activity_streaks) != 0) {
+        return 1;
+    }
+    int first = activity->weeks[0].day < activity->days[0].day ? activity->weeks[0].day : activity->days[0].day;
+    sqlite3_bind_int(activity_days_stmt, 1, first);
+    sqlite3_bind_int(activity_days_stmt, 2, end);
+    result = sqlite3_step(activity_days_stmt);
+    while (result == SQLITE_ROW) {
+        day_counts_t row = {
+            .day = sqlite3_column_int(activity_days_stmt, 0),
+            .created = sqlite3_column_int(activity_days_stmt, 1),
+            .completed = sqlite3_column_int(activity_days_stmt, 2),
+            .cleared = sqlite3_column_int(activity_days_stmt, 3),
+        };
+        day_counts_t *counts[2] = {NULL, NULL};
+        if (row.day >= activity->days[0].day) {
+            counts[0] = &activity->days[row.day - activity->days[0].day];
+        }
+        if (row.day >= activity->weeks[0].day) {
+            counts[1] = &activity->weeks[(row.day - activity->weeks[0].day) / 7];
+        }
+        for (int i = 0; i < 2; i++) {
+            if (counts[i] != NULL) {
+                counts[i]->created += row.created;
+                counts[i]->completed += row.completed;
+                counts[i]->cleared += row.cleared;
+            }
+        }
+        result = sqlite3_step(activity_days_stmt);
+    }
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_activity_days_stmt: %s\n", sqlite3_errmsg(DB));
+        return_defer(result);
+    }
+    sqlite3_bind_int(activity_streaks_stmt, 1, today);
+    result = sqlite3_step(activity_streaks_stmt);
+    if (result != SQLITE_ROW) {
+        fprintf(stderr, "[error] step_activity_streaks_stmt: %s\n", sqlite3_errmsg(DB));
+        return_defer(result);
+    }
+    activity->streak = sqlite3_column_int(activity_streaks_stmt, 0);
+    activity->longest_streak = sqlite3_column_int(activity_streaks_stmt, 1);
+    return_defer(0);
+defer:
+    sqlite3_reset(activity_days_stmt);
+    sqlite3_reset(activity_streaks_stmt);
+    return result;
+}
+
+// Draws the counts of a day or a week on one row, after its label
+void draw_day_counts(renderer_t *r, int row, const char *label, const day_counts_t *counts) {
+    draw_fmt(r, row, 0, ATTR_NONE, "%-16s %9d %9d %9d", label, counts->created, counts->completed, counts->cleared);
+}
+
+// Draws an entry on one row. A description longer than the rest of the row is cut short with an
+// ellipsis in the last column.
+void draw_entry(renderer_t *r, int row, const entry_t *entry, int selected) {
+    int col = 0;
+    if (selected) {
+        col = draw_text(r, row, col, ATTR_YELLOW, "> ", 2);
+    } else {
+        col += 2;
+    }
+    col = draw_text(r, row, col, ATTR_NONE, entry->completed ? "[x] " : "[ ] ", 4);
+    int attr = entry->completed ? ATTR_STRIKETHROUGH : ATTR_NONE;
+    const char *description = entry->description;
+    int len = strlen(description);
+    int room = r->back.cols - col;
+    int end = 0, last = 0;
+    for (int width = 0; end < len && width < room; width++) {
+        last = end;
+        end += utf8_seq_len((unsigned char)description[end]);
+    }
+    if (end < len) {
+        col = draw_text(r, row, col, attr, description, last);
+        draw_text(r, row, col, attr, "\u2026", 3);
+    } else {
+        draw_text(r, row, col, attr, description, len);
+    }
+}
+
+// Line editor
+//
+// The new entry, edit and search views edit their text in a gap buffer: the text before the cursor
+// sits at the start of buf, the text after it at the end, and the unused gap in between. Typing and
+// deleting only move the edges of the gap, and moving the cursor carries one codepoint across it, so
+// no key costs more for a longer line. The cursor always sits on a codepoint boundary.
+
+#define EDITOR_MIN_CAP 64
+
+typedef struct Editor {
+    char *buf;
+    int cap;
+    int gap_start; // the cursor
+    int gap_end;
+    char *text; // contiguous copy of the line, see editor_text()
+    int text_cap;
+} editor_t;
+
+void editor_init(editor_t *ed) { memset(ed, 0, sizeof(*ed)); }
+
+void editor_free(editor_t *ed) {
+    free(ed->buf);
+    free(ed->text);
+}
+
+int editor_len(const editor_t *ed) { return ed->cap - (ed->gap_end - ed->gap_start); }
+
+int is_utf8_continuation(char c) { return ((unsigned char)c & 0xC0) == 0x80; }
+
+// Grows the gap to at least n bytes, doubling the buffer so inserts are amortized O(1)
+int editor_reserve(editor_t *ed, int n) {
+    if (ed->gap_end - ed->gap_start >= n) {
+        return 0;
+    }
+    int len = editor_len(ed);
+    int cap = ed->cap > 0 ? ed->cap * 2 : EDITOR_MIN_CAP;
+    while (cap < len + n) {
+        cap *= 2;
+    }
+    char *buf = realloc(ed->buf, cap);
+    if (buf == NULL) {
+        return 1;
+    }
+    int tail = ed->cap - ed->gap_end;
+    memmove(buf + cap - tail, buf + ed->gap_end, tail);
+    ed->buf = buf;
+    ed->gap_end = cap - tail;
+    ed->cap = cap;
+    return 0;
+}
+
+int editor_insert(editor_t *ed, const char *text, int len) {
+    if (editor_reserve(ed, len) != 0) {
+        return 1;
+    }
+    memcpy(ed->buf + ed->gap_start, text, len);
+    ed->gap_start += len;
+    return 0;
+}
+
+void editor_clear(editor_t *ed) {
+    ed->gap_start = 0;
+    ed->gap_end = ed->cap;
+}
+
+int editor_set(editor_t *ed, const char *text, int len) {
+    editor_clear(ed);
+    return editor_insert(ed, text, len);
+}
+
+// Deletes the codepoint before the cursor
+void editor_backspace(editor_t *ed) {
+    while (ed->gap_start > 0 && is_utf8_continuation(ed->buf[--ed->gap_start])) {
+    }
+}
+
+// Deletes the codepoint under the cursor
+void editor_delete(editor_t *ed) {
+    if (ed->gap_end < ed->cap) {
+        ed->gap_end++;
+    }
+    while (ed->gap_end < ed->cap && is_utf8_continuation(ed->buf[ed->gap_end])) {
+        ed->gap_end++;
+    }
+}
+
+void editor_left(editor_t *ed) {
+    int start = ed->gap_start;
+    while (start > 0 && is_utf8_continuation(ed->buf[--start])) {
+    }
+    int n = ed->gap_start - start;
+    memmove(ed->buf + ed->gap_end - n, ed->buf + start, n);
+    ed->gap_start -= n;
+    ed->gap_end -= n;
+}
+
+void editor_right(editor_t *ed) {
+    int end = ed->gap_end;
+    if (end < ed->cap) {
+        end++;
+    }
+    while (end < ed->cap && is_utf8_continuation(ed->buf[end])) {
+        end++;
+    }
+    int n = end - ed->gap_end;
+    memmove(ed->buf + ed->gap_start, ed->buf + ed->gap_end, n);
+    ed->gap_start += n;
+    ed->gap_end += n;
+}
+
+void editor_home(editor_t *ed) {
+    memmove(ed->buf + ed->gap_end - ed->gap_start, ed->buf, ed->gap_start);
+    ed->gap_end -= ed->gap_start;
+    ed->gap_start = 0;
+}
+
+void editor_end(editor_t *ed) {
+    int tail = ed->cap - ed->gap_end;
+    memmove(ed->buf + ed->gap_start, ed->buf + ed->gap_end, tail);
+    ed->gap_start += tail;
+    ed->gap_end = ed->cap;
+}
+
+// The whole line as one NUL terminated string, valid until the editor changes. Copies the line, so
+// it is meant for saving and searching, not for every keypress.
+const char *editor_text(editor_t *ed, int *len) {
+    *len = editor_len(ed);
+    if (ed->text_cap < *len + 1) {
+        char *text = realloc(ed->text, *len + 1);
+        if (text == NULL) {
+            *len = 0;
+            return "";
+        }
+        ed->text = text;
+        ed->text_cap = *len + 1;
+    }
+    memcpy(ed->text, ed->buf, ed->gap_start);
+    memcpy(ed->text + ed->gap_start, ed->buf + ed->gap_end, ed->cap - ed->gap_end);
+    ed->text[*len] = '\0';
+    return ed->text;
+}
+
+int utf8_codepoints(const char *s, int len) {
+    int n = 0;
+    for (int i = 0; i < len; i++) {
+        n += !is_utf8_continuation(s[i]);
+    }
+    return n;
+}
+
+// Draws the line from col to the end of the row and places the terminal cursor on it, scrolling
+// the line horizontally when the cursor would fall off the screen
+void editor_draw(renderer_t *r, int row, int col, editor_t *ed) {
+    int width = r->back.cols - col - 1;
+    int skip = utf8_codepoints(ed->buf, ed->gap_start) - (width > 0 ? width : 0);
+    int start = 0;
+    for (; skip > 0 && start < ed->gap_start; skip--) {
+        start += utf8_seq_len((unsigned char)ed->buf[start]);
+    }
+    if (start > ed->gap_start) {
+        start = ed->gap_start;
+    }
+    int cursor_col = draw_text(r, row, col, ATTR_NONE, ed->buf + start, ed->gap_start - start);
+    draw_text(r, row, cursor_col, ATTR_NONE, ed->buf + ed->gap_end, ed->cap - ed->gap_end);
+    draw_cursor(r, row, cursor_col);
+}
+
+// Incremental auto-vacuum lets archiving give pages back to the file system, see archive_compact().
+// Switching a database to it takes a full VACUUM, so it is done once, right after the migrations
+// that create or upgrade the database.
+int enable_incremental_vacuum(void) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    check_db_err(sqlite3_prepare_v2(DB, "PRAGMA auto_vacuum;", -1, &stmt, 0), "prepare_auto_vacuum");
+    int mode = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    if (mode != 2) {
+        check_db_err(sqlite3_exec(DB, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", NULL, NULL, NULL), "vacuum");
+    }
+    return_defer(0);
+defer:
+    return result;
+}
+
+// Opens the database and brings its schema up to date. A database at the current version is only
+// read from: it has been in WAL mode, which sticks to the file, since it was created or migrated.
+int open_db(const char *path) {
+    int result = 0;
+    check_db_err(sqlite3_open(path, &DB), "sqlite3_open");
+    // Other instances may be writing: wait for their locks instead of failing with SQLITE_BUSY
+    check_db_err(sqlite3_busy_timeout(DB, DB_BUSY_TIMEOUT_MS), "busy_timeout");
+    check_db_err(sqlite3_exec(DB, set_mmap_size_sql, NULL, 0, NULL), "mmap_size");
+    startup_mark(STARTUP_OPEN);
+
+    int db_version;
+    if (get_db_version(&db_version) != 0) {
+        fprintf(stderr, "[error] get_db_version: %s\n", sqlite3_errmsg(DB));
+        return_defer(1);
+    }
+    if (db_version != MIGRATIONS_COUNT) {
+        // Use WAL so reads never block on the writes of other instances
+        check_db_err(sqlite3_exec(DB, "PRAGMA journal_mode = WAL;", NULL, 0, NULL), "wal");
+        check_db_err(sqlite3_exec(DB, create_table_entries_sql, NULL, 0, NULL), "create_table_entries");
+        int migrated;
+        if (run_migrations(&migrated) != 0) {
+            return_defer(1);
+        }
+        if (migrated) {
+            if (enable_incremental_vacuum() != 0) {
+                return_defer(1);
+            }
+        }
+    }
+    startup_mark(STARTUP_SCHEMA);
+    return_defer(0);
+defer:
+    return result;
+}
+
+void finalize_read_stmts(void) {
+    sqlite3_stmt **stmts[] = {&get_entries_after_stmt,          &get_entries_before_stmt,
+                              &get_filtered_entries_after_stmt, &get_filtered_entries_before_stmt,
+                              &get_tagged_entries_after_stmt,   &get_tagged_entries_before_stmt,
+                              &get_tags_stmt,                   &search_entries_stmt,
+                              &activity_days_stmt,              &activity_streaks_stmt};
+    for (size_t i = 0; i < sizeof(stmts) / sizeof(stmts[0]); i++) {
+        sqlite3_finalize(*stmts[i]);
+        *stmts[i] = NULL;
+    }
+}
+
+// Command line
+//
+// `tday <command>` runs without touching the terminal. Bulk import and export stream one task per
+// line, either as text (`[ ] description`, `[x] description` or just `description`) or as JSON lines
+// (`{"id":1,"description":"...","completed":false,"updated_at":null}`), so memory use doesn't grow
+// with the number of tasks.
+
+#define IMPORT_BATCH_ROWS 50000
+
+// Imported rows are staged in a temp table and moved into entries with one statement per batch.
+// FTS5 flushes its pending index data at every statement boundary, so inserting row by row through
+// insert_entry_stmt would write a tiny index segment per task and make imports several times slower.
+#define create_import_batch_sql                   \
+    "CREATE TEMP TABLE IF NOT EXISTS import_batch(" \
+    "id INTEGER PRIMARY KEY, "                      \
+    "description TEXT NOT NULL, "                   \
+    "completed INTEGER, "                           \
+    "day INTEGER"                                   \
+    ");"
+
+#define stage_import_entry_sql "INSERT INTO temp.import_batch (description, completed, day) VALUES (?, ?, ?);"
+
+// Staged rows are numbered from 1 in the order they were read; the batch gets its ids from one
+// reservation starting at %lld, and goes after the tasks its days already have in the same order
+#define flush_import_batch_sql                                                                        \
+    "INSERT INTO entries (id, description, completed, day, position) "                                \
+    "SELECT %lld + b.id - 1, b.description, b.completed, b.day, "                                     \
+    "(SELECT ifnull(max(position), 0) FROM entries WHERE day = b.day AND ignored = 0) + b.id * 1024 " \
+    "FROM temp.import_batch AS b;"                                                                    \
+    "DELETE FROM temp.import_batch;"
+
+// Every non-cleared entry, day by day in list order, read straight off entries_list_idx
+#define export_entries_sql                                             \
+    "SELECT id, description, completed, updated_at, day FROM entries " \
+    "WHERE ignored = 0 ORDER BY day ASC, position ASC, id ASC;"
+
+// One day's list, for `tday list`
+#define list_day_entries_sql                                           \
+    "SELECT id, description, completed, updated_at, day FROM entries " \
+    "WHERE ignored = 0 AND day = ? ORDER BY position ASC, id ASC;"
+
+#define get_entry_sql \
+    "SELECT id, description, completed, updated_at, day, position FROM entries WHERE id = ? AND ignored = 0;"
+
+// Position after the last task of a day, see POSITION_STEP
+#define day_end_position_sql "SELECT ifnull(max(position), 0) + 1024 FROM entries WHERE day = ? AND ignored = 0;"
+
+// The positions around place ?3 of a day's list, leaving out the task being moved
+#define move_neighbours_sql \
+    "SELECT position FROM entries WHERE day = ?1 AND ignored = 0 AND id != ?2 ORDER BY position, id LIMIT 2 OFFSET ?3;"
+
+void usage(void) {
+    fprintf(stderr, "usage: tday [command]\n"
+                    "       tday --daemon\n"
+                    "       tday --replay <keys>\n"
+                    "       tday --time-startup\n"
+                    "\n"
+                    "without a command, tday starts the interactive list, as a client of the daemon if one\n"
+                    "is running. --daemon serves the tasks to every client on " socket_file_path ". --replay\n"
+                    "feeds the list the keys in a file, - for stdin, and writes the frames to stdout.\n"
+                    "--time-startup starts up like the list, writes its first frame to stdout and how long\n"
+                    "each phase took to stderr\n"
+                    "\n"
+                    "commands:\n"
+                    "  add <description>   add a task\n"
+                    "  list [--json]       print today's list with task ids\n"
+                    "  done <id>           mark a task as completed\n"
+                    "  move <id> <n>       move a task to place n of its day's list\n"
+                    "  rollover            move unfinished tasks of earlier days to today\n"
+                    "  import [--json]     add the tasks read from stdin, one per line\n"
+                    "  export [--json]     write the list to stdout, one task per line\n"
+                    "  archive             move cleared tasks to the archive and shrink the database\n"
+                    "  export-changes [--since seq]\n"
+                    "                      write the changes made after seq to stdout, for apply-changes\n"
+                    "  apply-changes       merge the changes read from stdin, e.g. from another machine\n");
+}
+
+void json_write_string(FILE *out, const char *s, int len) {
+    fputc('"', out);
+    for (int i = 0; i < len; i++) {
+        unsigned char c = s[i];
+        switch (c) {
+        case '"':
+            fputs("\\\"", out);
+            break;
+        case '\\':
+            fputs("\\\\", out);
+            break;
+        case '\n':
+            fputs("\\n", out);
+            break;
+        case '\t':
+            fputs("\\t", out);
+            break;
+        case '\r':
+            fputs("\\r", out);
+            break;
+        default:
+            if (c < 0x20) {
+                fprintf(out, "\\u%04x", c);
+            } else {
+                fputc(c, out);
+            }
+        }
+    }
+    fputc('"', out);
+}
+
+void json_skip_ws(const char **p) {
+    while (**p == ' ' || **p == '\t' || **p == '\r' || **p == '\n') {
+        (*p)++;
+    }
+}
+
+void utf8_encode(unsigned int cp, char *out, int *n) {
+    if (cp < 0x80) {
+        out[(*n)++] = cp;
+    } else if (cp < 0x800) {
+        out[(*n)++] = 0xC0 | (cp >> 6);
+        out[(*n)++] = 0x80 | (cp & 0x3F);
+    } else if (cp < 0x10000) {
+        out[(*n)++] = 0xE0 | (cp >> 12);
+        out[(*n)++] = 0x80 | ((cp >> 6) & 0x3F);
+        out[(*n)++] = 0x80 | (cp & 0x3F);
+    } else {
+        out[(*n)++] = 0xF0 | (cp >> 18);
+        out[(*n)++] = 0x80 | ((cp >> 12) & 0x3F);
+        out[(*n)++] = 0x80 | ((cp >> 6) & 0x3F);
+        out[(*n)++] = 0x80 | (cp & 0x3F);
+    }
+}
+
+// Parses a JSON string at *p into out (at most cap - 1 bytes, NUL terminated). Returns 0 on success.
+int json_parse_string(const char **p, char *out, int cap) {
+    int n = 0;
+    if (**p != '"') {
+        return 1;
+    }
+    (*p)++;
+    while (**p != '"') {
+        char tmp[4];
+        int tmp_n = 0;
+        if (**p == '\0') {
+            return 1;
+        }
+        if (**p == '\\') {
+            (*p)++;
+            switch (**p) {
+            case 'n':
+                tmp[tmp_n++] = '\n';
+                break;
+            case 't':
+                tmp[tmp_n++] = '\t';
+                break;
+            case 'r':
+                tmp[tmp_n++] = '\r';
+                break;
+            case 'b':
+                tmp[tmp_n++] = '\b';
+                break;
+            case 'f':
+                tmp[tmp_n++] = '\f';
+                break;
+            case 'u': {
+                unsigned int cp = 0;
+                for (int i = 1; i <= 4; i++) {
+                    char h = (*p)[i];
+                    cp <<= 4;
+                    if (h >= '0' && h <= '9')
+                        cp |= h - '0';
+                    else if (h >= 'a' && h <= 'f')
+                        cp |= h - 'a' + 10;
+                    else if (h >= 'A' && h <= 'F')
+                        cp |= h - 'A' + 10;
+                    else
+                        return 1;
+                }
+                (*p) += 4;
+                utf8_encode(cp, tmp, &tmp_n);
+            } break;
+            case '\0':
+                return 1;
+            default:
+                tmp[tmp_n++] = **p;
+            }
+            (*p)++;
+        } else {
+            tmp[tmp_n++] = *(*p)++;
+        }
+        for (int i = 0; i < tmp_n && n < cap - 1; i++) {
+            out[n++] = tmp[i];
+        }
+    }
+    (*p)++;
+    out[n] = '\0';
+    return 0;
+}
+
+// Parses one JSON lines object into entry, picking up "description", "completed" and "day". The
+// description is decoded into description, which must hold strlen(line) + 1 bytes. Other keys are
+// skipped. Returns 0 on success.
+int json_parse_entry(const char *line, entry_t *entry, char *description) {
+    const char *p = line;
+    int has_description = 0;
+    json_skip_ws(&p);
+    if (*p++ != '{') {
+        return 1;
+    }
+    json_skip_ws(&p);
+    while (*p != '}') {
+        char key[32];
+        if (json_parse_string(&p, key, sizeof(key)) != 0) {
+            return 1;
+        }
+        json_skip_ws(&p);
+        if (*p++ != ':') {
+            return 1;
+        }
+        json_skip_ws(&p);
+        if (strcmp(key, "description") == 0) {
+            if (json_parse_string(&p, description, strlen(line) + 1) != 0) {
+                return 1;
+            }
+            entry->description = description;
+            has_description = 1;
+        } else if (strcmp(key, "day") == 0 && *p == '"') {
+            char day[DAY_STRING_SIZE];
+            if (json_parse_string(&p, day, sizeof(day)) != 0 || parse_day(day, &entry->day) != 0) {
+                return 1;
+            }
+        } else if (*p == '"') {
+            char skipped[8];
+            if (json_parse_string(&p, skipped, sizeof(skipped)) != 0) {
+                return 1;
+            }
+        } else {
+            const char *value = p;
+            while (*p != '\0' && *p != ',' && *p != '}' && *p != ' ' && *p != '\t') {
+                p++;
+            }
+            if (strcmp(key, "completed") == 0) {
+                entry->completed = strncmp(value, "true", 4) == 0 || strncmp(value, "1", 1) == 0;
+            }
+        }
+        json_skip_ws(&p);
+        if (*p == ',') {
+            p++;
+            json_skip_ws(&p);
+        } else if (*p != '}') {
+            return 1;
+        }
+    }
+    return has_description ? 0 : 1;
+}
+
+// Parses one text line: `[ ] description`, `[x] description` or a bare description. The
+// description points into line.
+int text_parse_entry(const char *line, int len, entry_t *entry) {
+    if (len >= 4 && line[0] == '[' && line[2] == ']' && line[3] == ' ') {
+        entry->completed = line[1] == 'x' || line[1] == 'X';
+        line += 4;
+        len -= 4;
+    }
+    if (len <= 0) {
+        return 1;
+    }
+    entry->description = line;
+    return 0;
+}
+
+// Sync
+//
+// Databases on different machines are synced by exchanging changes instead of copying files. `tday
+// export-changes --since seq` writes the changes logged after seq as JSON lines, and `tday apply-changes`
+// merges them into another database; both cost the changes exchanged, whatever the size of the list.
+// The log is kept by triggers, see migrate_change_log_v8_sql.
+//
+// Every change carries the whole entry, and an entry is in the state of its change with the highest
+// (clock, site), so databases that got the same changes hold the same entries, whatever the order the
+// changes came in. Clocks are Lamport clocks: applying changes moves the site's clock past theirs, so an
+// edit made after a sync wins over what the sync brought. Applied changes are logged as they came, so
+// the next export passes them on to a third database.
+
+#define SYNC_ID_SIZE 64
+
+typedef struct Change {
+    sqlite3_int64 seq; // position in the log of the database it was exported from
+    char uid[SYNC_ID_SIZE];
+    char site[SYNC_ID_SIZE];
+    sqlite3_int64 clock;
+    int deleted;
+    entry_t entry; // the entry after the change, unused when deleted
+} change_t;
+
+#define export_changes_sql                                                                               \
+    "SELECT seq, uid, clock, site, deleted, description, completed, ignored, day, updated_at, position " \
+    "FROM changes WHERE seq > ? ORDER BY seq LIMIT ?;"
+
+// The entry columns are ?1 to ?7 in every statement applying a change, see bind_change().
+// A change that is already in the log is ignored, see changes_uid_idx.
+#define log_change_sql                                                                         \
+    "INSERT OR IGNORE INTO changes "                                                           \
+    "(uid, description, completed, ignored, day, updated_at, position, clock, site, deleted) " \
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10);"
+
+#define change_superseded_sql "SELECT EXISTS (SELECT 1 FROM changes WHERE uid = ?1 AND (clock, site) > (?2, ?3));"
+
+#define apply_change_update_sql                                                                      \
+    "UPDATE entries SET description = ?2, completed = ?3, ignored = ?4, day = ?5, updated_at = ?6, " \
+    "position = ?7 WHERE uid = ?1;"
+
+#define apply_change_insert_sql                                                        \
+    "INSERT INTO entries (uid, description, completed, ignored, day, updated_at, position, id) " \
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8);"
+
+#define apply_change_delete_sql "DELETE FROM entries WHERE uid = ?1;"
+
+// Writes the changes logged after since to out, at most limit of them (-1 for all). Sets *exported to
+// their number and *last to the seq of the last one, since when there are none.
+int export_changes(sqlite3 *conn, sqlite3_int64 since, int limit, FILE *out, long *exported, sqlite3_int64 *last) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    (*exported) = 0;
+    (*last) = since;
+    check_conn_err(conn, sqlite3_prepare_v2(conn, export_changes_sql, -1, &stmt, 0), "prepare_export_changes_stmt");
+    sqlite3_bind_int64(stmt, 1, since);
+    sqlite3_bind_int(stmt, 2, limit);
+    result = sqlite3_step(stmt);
+    while (result == SQLITE_ROW) {
+        (*last) = sqlite3_column_int64(stmt, 0);
+        fprintf(out, "{\"seq\":%lld,\"uid\":", (long long)*last);
+        json_write_string(out, (const char *)sqlite3_column_text(stmt, 1), sqlite3_column_bytes(stmt, 1));
+        fprintf(out, ",\"clock\":%lld,\"site\":", (long long)sqlite3_column_int64(stmt, 2));
+        json_write_string(out, (const char *)sqlite3_column_text(stmt, 3), sqlite3_column_bytes(stmt, 3));
+        if (sqlite3_column_int(stmt, 4)) {
+            fprintf(out, ",\"deleted\":true}\n");
+        } else {
+            char day[DAY_STRING_SIZE];
+            format_day(sqlite3_column_int(stmt, 8), day);
+            fprintf(out, ",\"description\":");
+            json_write_string(out, (const char *)sqlite3_column_text(stmt, 5), sqlite3_column_bytes(stmt, 5));
+            fprintf(out, ",\"completed\":%s,\"ignored\":%lld,\"day\":\"%s\",\"updated_at\":",
+                    sqlite3_column_int(stmt, 6) ? "true" : "false", (long long)sqlite3_column_int64(stmt, 7), day);
+            if (sqlite3_column_type(stmt, 9) == SQLITE_NULL) {
+                fprintf(out, "null");
+            } else {
+                fprintf(out, "%lld", (long long)sqlite3_column_int64(stmt, 9));
+            }
+            fprintf(out, ",\"position\":%.17g}\n", sqlite3_column_double(stmt, 10));
+        }
+        (*exported)++;
+        result = sqlite3_step(stmt);
+    }
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_export_changes_stmt: %s\n", sqlite3_errmsg(conn));
+        return_defer(1);
+    }
+    return_defer(0);
+defer:
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// Parses one line written by export_changes(). The description is decoded into description, which must
+// hold strlen(line) + 1 bytes. Returns 0 on success.
+int json_parse_change(const char *line, change_t *change, char *description) {
+    const char *p = line;
+    int has_description = 0;
+    memset(change, 0, sizeof(*change));
+    json_skip_ws(&p);
+    if (*p++ != '{') {
+        return 1;
+    }
+    json_skip_ws(&p);
+    while (*p != '}') {
+        char key[32];
+        if (json_parse_string(&p, key, sizeof(key)) != 0) {
+            return 1;
+        }
+        json_skip_ws(&p);
+        if (*p++ != ':') {
+            return 1;
+        }
+        json_skip_ws(&p);
+        if (strcmp(key, "uid") == 0 || strcmp(key, "site") == 0) {
+            if (json_parse_string(&p, key[0] == 'u' ? change->uid : change->site, SYNC_ID_SIZE) != 0) {
+                return 1;
+            }
+        } else if (strcmp(key, "description") == 0) {
+            if (json_parse_string(&p, description, strlen(line) + 1) != 0) {
+                return 1;
+            }
+            change->entry.description = description;
+            has_description = 1;
+        } else if (strcmp(key, "day") == 0 && *p == '"') {
+            char day[DAY_STRING_SIZE];
+            if (json_parse_string(&p, day, sizeof(day)) != 0 || parse_day(day, &change->entry.day) != 0) {
+                return 1;
+            }
+        } else if (*p == '"') {
+            char skipped[8];
+            if (json_parse_string(&p, skipped, sizeof(skipped)) != 0) {
+                return 1;
+            }
+        } else {
+            const char *value = p;
+            while (*p != '\0' && *p != ',' && *p != '}' && *p != ' ' && *p != '\t') {
+                p++;
+            }
+            // null reads as 0
+            if (strcmp(key, "seq") == 0) {
+                change->seq = strtoll(value, NULL, 10);
+            } else if (strcmp(key, "clock") == 0) {
+                change->clock = strtoll(value, NULL, 10);
+            } else if (strcmp(key, "deleted") == 0) {
+                change->deleted = strncmp(value, "true", 4) == 0;
+            } else if (strcmp(key, "completed") == 0) {
+                change->entry.completed = strncmp(value, "true", 4) == 0;
+            } else if (strcmp(key, "ignored") == 0) {
+                change->entry.ignored = strtoll(value, NULL, 10);
+            } else if (strcmp(key, "updated_at") == 0) {
+                change->entry.updated_at = strtoll(value, NULL, 10);
+            } else if (strcmp(key, "position") == 0) {
+                change->entry.position = strtod(value, NULL);
+            }
+        }
+        json_skip_ws(&p);
+        if (*p == ',') {
+            p++;
+            json_skip_ws(&p);
+        } else if (*p != '}') {
+            return 1;
+        }
+    }
+    if (change->uid[0] == '\0' || change->site[0] == '\0' || change->clock <= 0) {
+        return 1;
+    }
+    return change->deleted || has_description ? 0 : 1;
+}
+
+// Binds the uid and the entry columns of change, see log_change_sql
+void bind_change(sqlite3_stmt *stmt, const change_t *change) {
+    sqlite3_bind_text(stmt, 1, change->uid, -1, SQLITE_STATIC);
+    if (change->deleted) {
+        return;
+    }
+    sqlite3_bind_text(stmt, 2, change->entry.description, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 3, change->entry.completed);
+    sqlite3_bind_int(stmt, 4, change->entry.ignored);
+    sqlite3_bind_int(stmt, 5, change->entry.day);
+    if (change->entry.updated_at != 0) {
+        sqlite3_bind_int64(stmt, 6, change->entry.updated_at);
+    }
+    sqlite3_bind_double(stmt, 7, change->entry.position);
+}
+
+// Steps a statement applying a change, reporting errors
+int step_change_stmt(sqlite3 *conn, sqlite3_stmt *stmt, const char *ctx) {
+    int result = sqlite3_step(stmt);
+    if (result != SQLITE_DONE && result != SQLITE_ROW) {
+        fprintf(stderr, "[error] step_%s_stmt: %s\n", ctx, sqlite3_errmsg(conn));
+    }
+    return result;
+}
+
+// Merges the changes read from in, one per line as written by export_changes(), in one transaction.
+// Sets *applied to the number of changes this database did not have yet, and *skipped to the number of
+// unreadable lines. Any unreadable line rolls the whole transaction back: the sender's --since would
+// otherwise move past a change that never arrived. Applying the same changes again is harmless.
+int apply_changes(sqlite3 *conn, FILE *in, long *applied, long *skipped) {
+    int result = 0;
+    sqlite3_stmt *log_stmt = NULL, *superseded_stmt = NULL, *update_stmt = NULL, *insert_stmt = NULL,
+                 *delete_stmt = NULL;
+    char *line = NULL;
+    size_t line_cap = 0;
+    char *description = NULL;
+    size_t description_cap = 0;
+    sqlite3_int64 max_clock = 0;
+    (*applied) = 0;
+    (*skipped) = 0;
+
+    check_conn_err(conn, sqlite3_prepare_v2(conn, log_change_sql, -1, &log_stmt, 0), "prepare_log_change_stmt");
+    check_conn_err(conn, sqlite3_prepare_v2(conn, change_superseded_sql, -1, &superseded_stmt, 0),
+                   "prepare_change_superseded_stmt");
+    check_conn_err(conn, sqlite3_prepare_v2(conn, apply_change_update_sql, -1, &update_stmt, 0),
+                   "prepare_apply_change_update_stmt");
+    check_conn_err(conn, sqlite3_prepare_v2(conn, apply_change_insert_sql, -1, &insert_stmt, 0),
+                   "prepare_apply_change_insert_stmt");
+    check_conn_err(conn, sqlite3_prepare_v2(conn, apply_change_delete_sql, -1, &delete_stmt, 0),
+                   "prepare_apply_change_delete_stmt");
+    // The triggers would log the changes as made here, they are logged as they came instead
+    check_conn_err(conn, sqlite3_exec(conn, "BEGIN IMMEDIATE; UPDATE sync_state SET paused = 1;", NULL, NULL, NULL),
+                   "begin_apply_changes");
+    while (getline(&line, &line_cap, in) != -1) {
+        if (description_cap < line_cap) {
+            free(description);
+            description_cap = line_cap;
+            description = malloc(description_cap);
+            if (description == NULL) {
+                fprintf(stderr, "[error] apply_changes: out of memory\n");
+                return_defer(1);
+            }
+        }
+        change_t change;
+        if (line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (json_parse_change(line, &change, description) != 0) {
+            (*skipped)++;
+            continue;
+        }
+
+        bind_change(log_stmt, &change);
+        sqlite3_bind_int64(log_stmt, 8, change.clock);
+        sqlite3_bind_text(log_stmt, 9, change.site, -1, SQLITE_STATIC);
+        sqlite3_bind_int(log_stmt, 10, change.deleted);
+        if (step_change_stmt(conn, log_stmt, "log_change") != SQLITE_DONE) {
+            return_defer(1);
+        }
+        sqlite3_reset(log_stmt);
+        sqlite3_clear_bindings(log_stmt);
+        if (sqlite3_changes(conn) == 0) {
+            continue;
+        }
+        (*applied)++;
+        max_clock = change.clock > max_clock ? change.clock : max_clock;
+
+        // A later change to the entry was applied already
+        sqlite3_bind_text(superseded_stmt, 1, change.uid, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(superseded_stmt, 2, change.clock);
+        sqlite3_bind_text(superseded_stmt, 3, change.site, -1, SQLITE_STATIC);
+        if (step_change_stmt(conn, superseded_stmt, "change_superseded") != SQLITE_ROW) {
+            return_defer(1);
+        }
+        int superseded = sqlite3_column_int(superseded_stmt, 0);
+        sqlite3_reset(superseded_stmt);
+        if (superseded) {
+            continue;
+        }
+
+        if (change.deleted) {
+            bind_change(delete_stmt, &change);
+            result = step_change_stmt(conn, delete_stmt, "apply_change_delete");
+            sqlite3_reset(delete_stmt);
+            if (result != SQLITE_DONE) {
+                return_defer(1);
+            }
+            continue;
+        }
+        bind_change(update_stmt, &change);
+        result = step_change_stmt(conn, update_stmt, "apply_change_update");
+        sqlite3_reset(update_stmt);
+        sqlite3_clear_bindings(update_stmt);
+        if (result != SQLITE_DONE) {
+            return_defer(1);
+        }
+        if (sqlite3_changes(conn) > 0) {
+            continue;
+        }
+        // New here, or archived: it gets a local id
+        sqlite3_int64 id;
+        if (reserve_entry_ids(conn, 1, &id) != 0) {
+            return_defer(1);
+        }
+        bind_change(insert_stmt, &change);
+        sqlite3_bind_int64(insert_stmt, 8, id);
+        result = step_change_stmt(conn, insert_stmt, "apply_change_insert");
+        sqlite3_reset(insert_stmt);
+        sqlite3_clear_bindings(insert_stmt);
+        if (result != SQLITE_DONE) {
+            return_defer(1);
+        }
+    }
+    if (*skipped > 0) {
+        fprintf(stderr, "[error] apply_changes: %ld unreadable lines, nothing was applied\n", *skipped);
+        (*applied) = 0;
+        return_defer(1);
+    }
+    char sql[128];
+    snprintf(sql, sizeof(sql), "UPDATE sync_state SET clock = max(clock, %lld), paused = 0; COMMIT;",
+             (long long)max_clock);
+    check_conn_err(conn, sqlite3_exec(conn, sql, NULL, NULL, NULL), "commit_apply_changes");
+    return_defer(0);
+defer:
+    if (result != 0 && !sqlite3_get_autocommit(conn)) {
+        sqlite3_exec(conn, "ROLLBACK;", NULL, NULL, NULL);
+    }
+    sqlite3_finalize(log_stmt);
+    sqlite3_finalize(superseded_stmt);
+    sqlite3_finalize(update_stmt);
+    sqlite3_finalize(insert_stmt);
+    sqlite3_finalize(delete_stmt);
+    free(line);
+    free(description);
+    return result;
+}
+
+// Reads the position after the last task of day into *position
+int day_end_position(int day, double *position) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    check_db_err(sqlite3_prepare_v2(DB, day_end_position_sql, -1, &stmt, 0), "prepare_day_end_position_stmt");
+    sqlite3_bind_int(stmt, 1, day);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        fprintf(stderr, "[error] step_day_end_position_stmt: %s\n", sqlite3_errmsg(DB));
+        return_defer(1);
+    }
+    (*position) = sqlite3_column_double(stmt, 0);
+    return_defer(0);
+defer:
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+int cmd_add(int argc, char **argv) {
+    if (argc < 1) {
+        usage();
+        return 1;
+    }
+    entry_t entry = {0};
+    entry.id = new_entry_id();
+    entry.day = today();
+    entry.description = argv[0];
+    if (entry.id == 0 || day_end_position(entry.day, &entry.position) != 0 || new_entry(&entry) != 0) {
+        return 1;
+    }
+    printf("%d\n", entry.id);
+    return 0;
+}
+
+int cmd_done(int argc, char **argv) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    char *description = NULL;
+    if (argc < 1) {
+        usage();
+        return 1;
+    }
+    check_db_err(sqlite3_prepare_v2(DB, get_entry_sql, -1, &stmt, 0), "prepare_get_entry_stmt");
+    sqlite3_bind_int64(stmt, 1, strtoll(argv[0], NULL, 10));
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        fprintf(stderr, "[error] no task with id %s\n", argv[0]);
+        return_defer(1);
+    }
+    entry_t entry = {0};
+    entry.id = sqlite3_column_int(stmt, 0);
+    description = strdup((const char *)sqlite3_column_text(stmt, 1));
+    if (description == NULL) {
+        return_defer(1);
+    }
+    entry.description = description;
+    entry.completed = 1;
+    entry.updated_at = time(NULL);
+    entry.position = sqlite3_column_double(stmt, 5);
+    sqlite3_reset(stmt);
+    return_defer(update_entry(&entry) != 0);
+defer:
+    sqlite3_finalize(stmt);
+    free(description);
+    return result;
+}
+
+// Moves a task to place n, counted from 1, of its day's list. Only its row is written, unless the
+// positions around place n are too close to split, see list_move_selected().
+int cmd_move(int argc, char **argv) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL, *neighbours_stmt = NULL;
+    char *description = NULL;
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    int place = atoi(argv[1]);
+    place = place < 1 ? 1 : place;
+    check_db_err(sqlite3_prepare_v2(DB, get_entry_sql, -1, &stmt, 0), "prepare_get_entry_stmt");
+    check_db_err(sqlite3_prepare_v2(DB, move_neighbours_sql, -1, &neighbours_stmt, 0),
+                 "prepare_move_neighbours_stmt");
+    sqlite3_bind_int64(stmt, 1, strtoll(argv[0], NULL, 10));
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        fprintf(stderr, "[error] no task with id %s\n", argv[0]);
+        return_defer(1);
+    }
+    entry_t entry = {0};
+    entry.id = sqlite3_column_int(stmt, 0);
+    description = strdup((const char *)sqlite3_column_text(stmt, 1));
+    if (description == NULL) {
+        return_defer(1);
+    }
+    entry.description = description;
+    entry.completed = sqlite3_column_int(stmt, 2);
+    entry.updated_at = sqlite3_column_int64(stmt, 3);
+    entry.day = sqlite3_column_int(stmt, 4);
+    sqlite3_reset(stmt);
+    // A second try follows a rebalance
+    for (int attempt = 0; attempt < 2; attempt++) {
+        entry_t neighbours[2] = {0};
+        int found = 0;
+        sqlite3_bind_int(neighbours_stmt, 1, entry.day);
+        sqlite3_bind_int(neighbours_stmt, 2, entry.id);
+        sqlite3_bind_int(neighbours_stmt, 3, place >= 2 ? place - 2 : 0);
+        while (found < 2 && (result = sqlite3_step(neighbours_stmt)) == SQLITE_ROW) {
+            neighbours[found++].position = sqlite3_column_double(neighbours_stmt, 0);
+        }
+        sqlite3_reset(neighbours_stmt);
+        if (result != SQLITE_ROW && result != SQLITE_DONE) {
+            fprintf(stderr, "[error] step_move_neighbours_stmt: %s\n", sqlite3_errmsg(DB));
+            return_defer(1);
+        }
+        const entry_t *before, *after;
+        if (place == 1) {
+            before = NULL;
+            after = found > 0 ? &neighbours[0] : NULL;
+        } else if (found == 0) {
+            // Past the end of the list
+            check_db_err(day_end_position(entry.day, &neighbours[0].position), "day_end_position");
+            neighbours[0].position -= POSITION_STEP;
+            before = &neighbours[0];
+            after = NULL;
+        } else {
+            before = &neighbours[0];
+            after = found > 1 ? &neighbours[1] : NULL;
+        }
+        entry.position = position_between(before, after);
+        if (!position_crowded(entry.position, before, after)) {
+            break;
+        }
+        check_db_err(rebalance_entries(entry.day), "rebalance_entries");
+    }
+    return_defer(update_entry(&entry) != 0);
+defer:
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(neighbours_stmt);
+    free(description);
+    return result;
+}
+
+// Streams tasks to stdout. with_ids selects the `list` format, today's tasks only, over the importable
+// `export` one.
+int cmd_export(int json, int with_ids) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    check_db_err(sqlite3_prepare_v2(DB, with_ids ? list_day_entries_sql : export_entries_sql, -1, &stmt, 0),
+                 "prepare_export_entries_stmt");
+    if (with_ids) {
+        sqlite3_bind_int(stmt, 1, today());
+    }
+    result = sqlite3_step(stmt);
+    while (result == SQLITE_ROW) {
+        sqlite3_int64 id = sqlite3_column_int64(stmt, 0);
+        const char *description = (const char *)sqlite3_column_text(stmt, 1);
+        int len = sqlite3_column_bytes(stmt, 1);
+        int completed = sqlite3_column_int(stmt, 2);
+        if (json) {
+            printf("{\"id\":%lld,\"description\":", (long long)id);
+            json_write_string(stdout, description, len);
+            char day[DAY_STRING_SIZE];
+            format_day(sqlite3_column_int(stmt, 4), day);
+            printf(",\"completed\":%s,\"day\":\"%s\",\"updated_at\":", completed ? "true" : "false", day);
+            if (sqlite3_column_type(stmt, 3) == SQLITE_NULL) {
+                printf("null}\n");
+            } else {
+                printf("%lld}\n", (long long)sqlite3_column_int64(stmt, 3));
+            }
+        } else if (with_ids) {
+            printf("%6lld %s %.*s\n", (long long)id, completed ? "[x]" : "[ ]", len, description);
+        } else {
+            printf("%s %.*s\n", completed ? "[x]" : "[ ]", len, description);
+        }
+        result = sqlite3_step(stmt);
+    }
+    if (result != SQLITE_DONE) {
+        fprintf(stderr, "[error] step_export_entries_stmt: %s\n", sqlite3_errmsg(DB));
+        return_defer(1);
+    }
+    return_defer(fflush(stdout) != 0);
+defer:
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// Adds every task read from stdin, committing once every IMPORT_BATCH_ROWS rows
+int cmd_import(int json) {
+    int result = 0;
+    sqlite3_stmt *stmt = NULL;
+    char *line = NULL;
+    size_t line_cap = 0;
+    char *description = NULL;
+    size_t description_cap = 0;
+    ssize_t len;
+    size_t imported = 0, skipped = 0, in_batch = 0;
+
+    check_db_err(sqlite3_exec(DB, create_import_batch_sql, NULL, NULL, NULL), "create_import_batch");
+    check_db_err(sqlite3_prepare_v2(DB, stage_import_entry_sql, -1, &stmt, 0), "prepare_stage_import_entry_stmt");
+    while (1) {
+        len = getline(&line, &line_cap, stdin);
+        if (in_batch > 0 && (len == -1 || in_batch == IMPORT_BATCH_ROWS)) {
+            sqlite3_int64 first;
+            check_db_err(reserve_entry_ids(DB, in_batch, &first), "reserve_entry_ids");
+            char flush_sql[512];
+            snprintf(flush_sql, sizeof(flush_sql), flush_import_batch_sql "COMMIT;", first);
+            check_db_err(sqlite3_exec(DB, flush_sql, NULL, NULL, NULL), "flush_import_batch");
+            imported += in_batch;
+            in_batch = 0;
+        }
+        if (len == -1) {
+            break;
+        }
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+        if (json && description_cap < line_cap) {
+            free(description);
+            description_cap = line_cap;
+            description = malloc(description_cap);
+            if (description == NULL) {
+                fprintf(stderr, "[error] cmd_import: out of memory\n");
+                return_defer(1);
+            }
+        }
+        entry_t entry = {.day = today()};
+        int err = json ? json_parse_entry(line, &entry, description) : text_parse_entry(line, len, &entry);
+        if (err != 0) {
+            skipped++;
+            continue;
+        }
+        if (in_batch == 0) {
+            check_db_err(sqlite3_exec(DB, "BEGIN;", NULL, NULL, NULL), "begin_import_batch");
+        }
+        sqlite3_bind_text(stmt, 1, entry.description, -1, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, entry.completed);
+        sqlite3_bind_int(stmt, 3, entry.day);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            fprintf(stderr, "[error] step_stage_import_entry_stmt: %s\n", sqlite3_errmsg(DB));
+            return_defer(1);
+        }
+        sqlite3_reset(stmt);
+        in_batch++;
+    }
+    fprintf(stderr, "imported %zu tasks", imported);
+    if (skipped > 0) {
+        fprintf(stderr, ", skipped %zu unreadable lines", skipped);
+    }
+    fprintf(stderr, "\n");
+    return_defer(0);
+defer:
+    if (result != 0) {
+        sqlite3_exec(DB, "ROLLBACK;", NULL, NULL, NULL);
+    }
+    sqlite3_finalize(stmt);
+    free(line);
+    free(description);
+    return result;
+}
+
+int cmd_rollover(void) {
+    if (rollover_entries(today()) != 0) {
+        return 1;
+    }
+    fprintf(stderr, "rolled over %d tasks\n", sqlite3_changes(DB));
+    return 0;
+}
+
+// Archives every cleared task right away, instead of leaving it to the next interactive session
+int cmd_archive(void) {
+    long archived = 0;
+    int moved;
+    do {
+        moved = archive_entries(DB, LLONG_MAX);
+        if (moved < 0) {
+            return 1;
+        }
+        archived += moved;
+    } while (moved == ARCHIVE_BATCH_ROWS);
+    if (archive_compact(DB) != 0) {
+        return 1;
+    }
+    fprintf(stderr, "archived %ld tasks to %s\n", archived, archive_file_path);
+    return 0;
+}
+
+// Writes the changes logged after `--since seq` to stdout, every change when it is left out
+int cmd_export_changes(int argc, char **argv) {
+    sqlite3_int64 since = 0;
+    if (argc > 0 && strcmp(argv[0], "--since") == 0) {
+        if (argc < 2) {
+            usage();
+            return 1;
+        }
+        since = strtoll(argv[1], NULL, 10);
+    }
+    long exported;
+    sqlite3_int64 last;
+    if (export_changes(DB, since, -1, stdout, &exported, &last) != 0 || fflush(stdout) != 0) {
+        return 1;
+    }
+    fprintf(stderr, "exported %ld changes, export the next ones with --since %lld\n", exported, (long long)last);
+    return 0;
+}
+
+int cmd_apply_changes(void) {
+    long applied, skipped;
+    if (apply_changes(DB, stdin, &applied, &skipped) != 0) {
+        return 1;
+    }
+    fprintf(stderr, "applied %ld new changes\n", applied);
+    return 0;
+}
+
+int run_command(int argc, char **argv) {
+    const char *cmd = argv[0];
+    int json = argc > 1 && strcmp(argv[1], "--json") == 0;
+    if (strcmp(cmd, "add") == 0) {
+        return cmd_add(argc - 1, argv + 1);
+    } else if (strcmp(cmd, "list") == 0) {
+        return cmd_export(json, 1);
+    } else if (strcmp(cmd, "done") == 0) {
+        return cmd_done(argc - 1, argv + 1);
+    } else if (strcmp(cmd, "move") == 0) {
+        return cmd_move(argc - 1, argv + 1);
+    } else if (strcmp(cmd, "import") == 0) {
+        return cmd_import(json);
+    } else if (strcmp(cmd, "export") == 0) {
+        return cmd_export(json, 0);
+    } else if (strcmp(cmd, "archive") == 0) {
+        return cmd_archive();
+    } else if (strcmp(cmd, "rollover") == 0) {
+        return cmd_rollover();
+    } else if (strcmp(cmd, "export-changes") == 0) {
+        return cmd_export_changes(argc - 1, argv + 1);
+    } else if (strcmp(cmd, "apply-changes") == 0) {
+        return cmd_apply_changes();
+    }
+    usage();
+    return 1;
+}
+
+// Daemon
+//
+// `tday --daemon` owns the task store for every frontend at once: it opens the database, prepares the
+// statements and runs the writer a single time, and serves clients over the Unix socket at
+// socket_file_path with the protocol described in the Client section. Requests are handled one at a
+// time on one thread. Writes go to the writer's queue, so writes from many clients still share
+// commits. The day listed last is kept in memory, whole: pages of it are answered without SQLite, and
+// writes patch it the way they patch the list view.
+
+#define DAEMON_MAX_CLIENTS 64
+#define DAEMON_CACHE_MAX_ROWS 4096
+#define DAEMON_PAGE_MAX 1024
+
+typedef struct DayCache {
+    int day;
+    int loaded;       // day was loaded since the last invalidation
+    int fits;         // the whole day fits, pages are answered from entries
+    entry_t *entries; // the day in list order, DAEMON_CACHE_MAX_ROWS + 1 of them
+    int entries_sz;
+    int copies; // descriptions copied into the arena since the day was loaded
+    arena_t arena;
+} day_cache_t;
+
+typedef struct DaemonClient {
+    int fd;
+    buffer_t in;
+    buffer_t out;
+    size_t out_pos;     // bytes of out already sent
+    long seen;          // version the client has seen, see daemon_t
+    sqlite3_int64 hold; // the client's oldest clear that can still be undone, see writer_hold_archive
+    filter_t filter;    // applied to the client's pages
+} daemon_client_t;
+
+typedef struct Daemon {
+    int listen_fd;
+    daemon_client_t clients[DAEMON_MAX_CLIENTS];
+    int clients_sz;
+    long version; // bumped by every change to the tasks
+    day_cache_t cache;
+    entry_t *page; // answers that don't come from the cache
+    arena_t page_arena;
+    search_t search;
+} daemon_t;
+
+volatile sig_atomic_t daemon_stopping = 0;
+
+void on_daemon_signal(int sig) {
+    (void)sig;
+    daemon_stopping = 1;
+}
+
+// Loads the whole of day, if it fits
+int cache_load(day_cache_t *cache, int day) {
+    if (cache->entries == NULL) {
+        cache->entries = malloc(sizeof(entry_t) * (DAEMON_CACHE_MAX_ROWS + 1));
+        if (cache->entries == NULL) {
+            return 1;
+        }
+    }
+    arena_reset(&cache->arena);
+    cache->day = day;
+    cache->copies = 0;
+    int result =
+        load_entries(day, NULL, NULL, 1, cache->entries, DAEMON_CACHE_MAX_ROWS + 1, &cache->entries_sz, &cache->arena);
+    cache->loaded = result == 0;
+    cache->fits = cache->entries_sz <= DAEMON_CACHE_MAX_ROWS;
+    return result;
+}
+
+// Index of the first cached entry that sorts after entry, or at or after it when !strict
+int cache_bound(const day_cache_t *cache, const entry_t *entry, int strict) {
+    int lo = 0, hi = cache->entries_sz;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = entry_cmp(&cache->entries[mid], entry);
+        if (cmp < 0 || (cmp == 0 && strict)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int cache_find(const day_cache_t *cache, int id) {
+    for (int i = 0; i < cache->entries_sz; i++) {
+        if (cache->entries[i].id == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void cache_remove(day_cache_t *cache, int index) {
+    memmove(cache->entries + index, cache->entries + index + 1, sizeof(entry_t) * (cache->entries_sz - index - 1));
+    cache->entries_sz--;
+}
+
+// Inserts entry at its place, with a copy of description. Rewritten descriptions pile up in the arena
+// until the day is loaded again, so the day is dropped once they add up to another full day.
+void cache_insert(day_cache_t *cache, const entry_t *entry, const char *description) {
+    entry_t copy = *entry;
+    if (description != NULL) {
+        copy.description = arena_strndup(&cache->arena, description, strlen(description));
+        if (copy.description == NULL || ++cache->copies > DAEMON_CACHE_MAX_ROWS) {
+            cache->loaded = 0;
+            return;
+        }
+    }
+    if (cache->entries_sz == DAEMON_CACHE_MAX_ROWS) {
+        cache->loaded = 0;
+        return;
+    }
+    int index = cache_bound(cache, &copy, 0);
+    memmove(cache->entries + index + 1, cache->entries + index, sizeof(entry_t) * (cache->entries_sz - index));
+    cache->entries[index] = copy;
+    cache->entries_sz++;
+}
+
+// Applies a write op to the cached day the way the writer applies it to the database. The ops that
+// change entries all over the list drop the day instead.
+void cache_apply(day_cache_t *cache, write_op_type_t type, const entry_t *entry) {
+    if (!cache->loaded || !cache->fits) {
+        return;
+    }
+    int index = cache_find(cache, entry->id);
+    switch (type) {
+    case WRITE_INSERT:
+        if (entry->day == cache->day && index < 0) {
+            cache_insert(cache, entry, entry->description);
+        }
+        break;
+    case WRITE_UPDATE: {
+        if (index < 0) {
+            break;
+        }
+        // An update doesn't move the entry to another day, and mostly leaves the description alone
+        entry_t updated = *entry;
+        updated.day = cache->day;
+        updated.description = cache->entries[index].description;
+        int rewritten = strcmp(updated.description, entry->description) != 0;
+        cache_remove(cache, index);
+        if (updated.ignored == 0) {
+            cache_insert(cache, &updated, rewritten ? entry->description : NULL);
+        }
+    } break;
+    case WRITE_DELETE:
+        if (index >= 0) {
+            cache_remove(cache, index);
+        }
+        break;
+    default:
+        cache->loaded = 0;
+        break;
+    }
+}
+
+int reply_entries(buffer_t *out, const entry_t *entries, int n, int step) {
+    int err = buffer_fmt(out, "OK %d\n", n);
+    for (int i = 0; i < n && err == 0; i++) {
+        err = buffer_append_entry(out, &entries[i * step]);
+    }
+    return err;
+}
+
+// PAGE day direction max [id position]
+int daemon_page(daemon_t *d, daemon_client_t *c, buffer_t *out, char *args) {
+    sqlite3_int64 day, direction, max, id;
+    if (parse_field(&args, &day) != 0 || parse_field(&args, &direction) != 0 || parse_field(&args, &max) != 0 ||
+        direction == 0 || max <= 0 || max > DAEMON_PAGE_MAX) {
+        return buffer_fmt(out, "ERR bad page request\n");
+    }
+    entry_t from = {0};
+    int has_from = *args != '\0';
+    if (has_from) {
+        if (parse_field(&args, &id) != 0 || parse_position(&args, &from.position) != 0) {
+            return buffer_fmt(out, "ERR bad page request\n");
+        }
+        from.id = id;
+    }
+    day_cache_t *cache = &d->cache;
+    if ((!cache->loaded || cache->day != day) && cache_load(cache, day) != 0) {
+        return buffer_fmt(out, "ERR could not load the day\n");
+    }
+    int step = direction > 0 ? 1 : -1;
+    int n = 0;
+    if (cache->fits) {
+        int start = has_from ? cache_bound(cache, &from, step > 0) : (step > 0 ? 0 : cache->entries_sz);
+        if (!filter_active(&c->filter)) {
+            int left = step > 0 ? cache->entries_sz - start : start;
+            n = left < max ? left : max;
+            return reply_entries(out, cache->entries + (step > 0 ? start : start - 1), n, step);
+        }
+        // The page points into the cache, nothing is copied
+        for (int i = step > 0 ? start : start - 1; i >= 0 && i < cache->entries_sz && n < max; i += step) {
+            if (filter_matches(&c->filter, &cache->entries[i])) {
+                d->page[n++] = cache->entries[i];
+            }
+        }
+        return reply_entries(out, d->page, n, 1);
+    }
+    arena_reset(&d->page_arena);
+    if (load_entries(day, &c->filter, has_from ? &from : NULL, step, d->page, max, &n, &d->page_arena) != 0) {
+        return buffer_fmt(out, "ERR could not load the page\n");
+    }
+    return reply_entries(out, d->page, n, 1);
+}
+
+// SEARCH max query
+int daemon_search(daemon_t *d, buffer_t *out, char *args) {
+    sqlite3_int64 max;
+    if (parse_field(&args, &max) != 0 || max <= 0 || max > DAEMON_PAGE_MAX) {
+        return buffer_fmt(out, "ERR bad search request\n");
+    }
+    unescape_text(args);
+    if (search_set_cap(&d->search, max) != 0 || search_entries(&d->search, args, strlen(args)) != 0) {
+        return buffer_fmt(out, "ERR search failed\n");
+    }
+    return reply_entries(out, d->search.results, d->search.results_sz, 1);
+}
+
+// ACTIVITY end today
+int daemon_activity(buffer_t *out, char *args) {
+    sqlite3_int64 end, today;
+    activity_t activity;
+    if (parse_field(&args, &end) != 0 || parse_field(&args, &today) != 0) {
+        return buffer_fmt(out, "ERR bad activity request\n");
+    }
+    if (load_activity(end, today, &activity) != 0) {
+        return buffer_fmt(out, "ERR activity failed\n");
+    }
+    int err = buffer_fmt(out, "OK %d %d\n", activity.streak, activity.longest_streak);
+    for (int i = 0; i < ACTIVITY_DAYS + ACTIVITY_WEEKS; i++) {
+        day_counts_t *counts = i < ACTIVITY_DAYS ? &activity.days[i] : &activity.weeks[i - ACTIVITY_DAYS];
+        err |= buffer_fmt(out, "%d %d %d %d\n", counts->day, counts->created, counts->completed, counts->cleared);
+    }
+    return err;
+}
+
+// FILTER priority [tag_id name]...
+int daemon_filter(daemon_client_t *c, buffer_t *out, char *args) {
+    sqlite3_int64 priority, id;
+    filter_t filter = {0};
+    if (parse_field(&args, &priority) != 0 || priority < 0 || priority > PRIORITY_MAX) {
+        return buffer_fmt(out, "ERR bad filter request\n");
+    }
+    filter.priority = priority;
+    while (*args != '\0') {
+        char *name = args;
+        if (filter.tags_sz == FILTER_MAX_TAGS || parse_field(&name, &id) != 0) {
+            return buffer_fmt(out, "ERR bad filter request\n");
+        }
+        args = name + strcspn(name, " ");
+        if (args == name || args - name >= TAG_NAME_SIZE) {
+            return buffer_fmt(out, "ERR bad filter request\n");
+        }
+        tag_t *tag = &filter.tags[filter.tags_sz++];
+        tag->id = id;
+        memcpy(tag->name, name, args - name);
+        tag->name[args - name] = '\0';
+        if (*args == ' ') {
+            args++;
+        }
+    }
+    c->filter = filter;
+    return buffer_fmt(out, "OK\n");
+}
+
+// TAGS max
+int daemon_tags(buffer_t *out, char *args) {
+    sqlite3_int64 max;
+    if (parse_field(&args, &max) != 0 || max <= 0 || max > DAEMON_PAGE_MAX) {
+        return buffer_fmt(out, "ERR bad tags request\n");
+    }
+    tag_t *tags = malloc(max * sizeof(tag_t));
+    int tags_sz = 0;
+    if (tags == NULL || load_tags(tags, max, &tags_sz) != 0) {
+        free(tags);
+        return buffer_fmt(out, "ERR tags failed\n");
+    }
+    int err = buffer_fmt(out, "OK %d\n", tags_sz);
+    for (int i = 0; i < tags_sz; i++) {
+        err |= buffer_fmt(out, "%d %s\n", tags[i].id, tags[i].name);
+    }
+    free(tags);
+    return err;
+}
+
+// WRITE op ignored id completed day updated_at position description
+int daemon_write(daemon_t *d, daemon_client_t *c, buffer_t *out, char *args) {
+    sqlite3_int64 type, ignored;
+    entry_t entry;
+    if (parse_field(&args, &type) != 0 || parse_field(&args, &ignored) != 0 || type < WRITE_INSERT ||
+        type > WRITE_REBALANCE || parse_entry_line(args, &entry) != 0) {
+        return buffer_fmt(out, "ERR bad write request\n");
+    }
+    entry.ignored = ignored;
+    cache_apply(&d->cache, type, &entry);
+    if (writer_push(type, &entry) != 0) {
+        return buffer_fmt(out, "ERR write failed\n");
+    }
+    // A client that was up to date stays so after its own write
+    if (c->seen == d->version) {
+        c->seen++;
+    }
+    d->version++;
+    return buffer_fmt(out, "OK\n");
+}
+
+// Holds back the archiving of the oldest clear any client can still undo
+void daemon_hold_archive(daemon_t *d) {
+    sqlite3_int64 oldest = 0;
+    for (int i = 0; i < d->clients_sz; i++) {
+        sqlite3_int64 hold = d->clients[i].hold;
+        if (hold != 0 && (oldest == 0 || hold < oldest)) {
+            oldest = hold;
+        }
+    }
+    writer_hold_archive(oldest);
+}
+
+// Handles one request line, appending the reply to the client's output
+int daemon_handle(daemon_t *d, daemon_client_t *c, char *line) {
+    buffer_t *out = &c->out;
+    char *args = strchr(line, ' ');
+    if (args != NULL) {
+        *args++ = '\0';
+    } else {
+        args = line + strlen(line);
+    }
+    if (strcmp(line, "PAGE") == 0) {
+        return daemon_page(d, c, out, args);
+    } else if (strcmp(line, "SEARCH") == 0) {
+        return daemon_search(d, out, args);
+    } else if (strcmp(line, "WRITE") == 0) {
+        return daemon_write(d, c, out, args);
+    } else if (strcmp(line, "FILTER") == 0) {
+        return daemon_filter(c, out, args);
+    } else if (strcmp(line, "TAGS") == 0) {
+        return daemon_tags(out, args);
+    } else if (strcmp(line, "ACTIVITY") == 0) {
+        return daemon_activity(out, args);
+    } else if (strcmp(line, "ID") == 0) {
+        sqlite3_int64 id = new_entry_id();
+        return id != 0 ? buffer_fmt(out, "OK %lld\n", (long long)id) : buffer_fmt(out, "ERR no free id\n");
+    } else if (strcmp(line, "CHANGED") == 0) {
+        int changed = c->seen != d->version;
+        c->seen = d->version;
+        return buffer_fmt(out, "OK %d\n", changed);
+    } else if (strcmp(line, "HOLD") == 0) {
+        sqlite3_int64 cleared_at;
+        if (parse_field(&args, &cleared_at) != 0) {
+            return buffer_fmt(out, "ERR bad hold request\n");
+        }
+        c->hold = cleared_at;
+        daemon_hold_archive(d);
+        return buffer_fmt(out, "OK\n");
+    }
+    return buffer_fmt(out, "ERR unknown request\n");
+}
+
+// Sends as much of the pending output as the socket takes. Returns 0 unless the client is gone.
+int daemon_flush(daemon_client_t *c) {
+    while (c->out_pos < c->out.len) {
+        ssize_t n = send(c->fd, c->out.data + c->out_pos, c->out.len - c->out_pos, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return errno != EAGAIN && errno != EWOULDBLOCK;
+        }
+        c->out_pos += n;
+    }
+    c->out.len = 0;
+    c->out_pos = 0;
+    return 0;
+}
+
+// Reads what the client sent and answers every complete request in it. Returns 0 unless the client is
+// gone.
+int daemon_read(daemon_t *d, daemon_client_t *c) {
+    if (buffer_reserve(&c->in, CLIENT_READ_SIZE) != 0) {
+        return 1;
+    }
+    ssize_t n = read(c->fd, c->in.data + c->in.len, c->in.cap - c->in.len);
+    if (n < 0) {
+        return errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK;
+    }
+    if (n == 0) {
+        return 1;
+    }
+    c->in.len += n;
+    size_t start = 0;
+    char *end;
+    while ((end = memchr(c->in.data + start, '\n', c->in.len - start)) != NULL) {
+        *end = '\0';
+        if (daemon_handle(d, c, c->in.data + start) != 0) {
+            return 1;
+        }
+        start = end + 1 - c->in.data;
+    }
+    c->in.len -= start;
+    memmove(c->in.data, c->in.data + start, c->in.len);
+    return daemon_flush(c);
+}
+
+void daemon_accept(daemon_t *d) {
+    int fd;
+    while ((fd = accept(d->listen_fd, NULL, NULL)) >= 0) {
+        if (d->clients_sz == DAEMON_MAX_CLIENTS || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+            close(fd);
+            continue;
+        }
+        daemon_client_t *c = &d->clients[d->clients_sz++];
+        memset(c, 0, sizeof(*c));
+        c->fd = fd;
+        c->seen = d->version;
+    }
+}
+
+void daemon_drop(daemon_t *d, int index) {
+    daemon_client_t *c = &d->clients[index];
+    int held = c->hold != 0;
+    close(c->fd);
+    buffer_free(&c->in);
+    buffer_free(&c->out);
+    d->clients[index] = d->clients[--d->clients_sz];
+    if (held) {
+        daemon_hold_archive(d);
+    }
+}
+
+// Listens at path, replacing a socket left behind by a daemon that is gone
+int daemon_listen(const char *path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "[error] daemon_listen: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        fprintf(stderr, "[error] daemon_listen: %s\n", strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, DAEMON_MAX_CLIENTS) != 0) {
+        fprintf(stderr, "[error] daemon_listen: %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Serves the database at db_path on the socket at socket_path until SIGINT or SIGTERM
+int daemon_run(const char *db_path, const char *socket_path) {
+    int result = 0;
+    static daemon_t d;
+    memset(&d, 0, sizeof(d));
+    d.listen_fd = -1;
+    struct pollfd fds[2 + DAEMON_MAX_CLIENTS];
+
+    if (client_connect(socket_path) == 0) {
+        fprintf(stderr, "[error] daemon_run: another daemon is serving %s\n", socket_path);
+        client_close();
+        return 1;
+    }
+    struct sigaction sa = {.sa_handler = on_daemon_signal};
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGINT, &sa, NULL) != 0 || sigaction(SIGTERM, &sa, NULL) != 0) {
+        return 1;
+    }
+    d.page = malloc(sizeof(entry_t) * DAEMON_PAGE_MAX);
+    if (d.page == NULL || search_init(&d.search, 1) != 0) {
+        return_defer(1);
+    }
+    if (open_db(db_path) != 0 || writer_start(db_path) != 0) {
+        return_defer(1);
+    }
+    d.listen_fd = daemon_listen(socket_path);
+    if (d.listen_fd < 0) {
+        return_defer(1);
+    }
+    fprintf(stderr, "serving %s on %s\n", db_path, socket_path);
+
+    double checked_at = now_us();
+    while (!daemon_stopping) {
+        int nfds = 0;
+        fds[nfds++] = (struct pollfd){.fd = d.listen_fd, .events = POLLIN};
+        fds[nfds++] = (struct pollfd){.fd = writer.notify[0], .events = POLLIN};
+        for (int i = 0; i < d.clients_sz; i++) {
+            short events = POLLIN | (d.clients[i].out.len > 0 ? POLLOUT : 0);
+            fds[nfds++] = (struct pollfd){.fd = d.clients[i].fd, .events = events};
+        }
+        if (poll(fds, nfds, EXTERNAL_CHANGE_POLL_MS) < 0 && errno != EINTR) {
+            fprintf(stderr, "[error] daemon_run: poll: %s\n", strerror(errno));
+            return_defer(1);
+        }
+        if (now_us() - checked_at >= EXTERNAL_CHANGE_POLL_MS * 1000.0) {
+            writer_check_changes();
+            checked_at = now_us();
+        }
+        // Another process committed: what is cached may be stale, and every client has changes to see
+        if (fds[1].revents & POLLIN) {
+            char drain[64];
+            while (read(writer.notify[0], drain, sizeof(drain)) > 0) {
+            }
+            d.cache.loaded = 0;
+            d.version++;
+        }
+        // Backwards, as dropping a client moves the last one into its slot
+        for (int i = d.clients_sz - 1; i >= 0; i--) {
+            short revents = fds[2 + i].revents;
+            int gone = 0;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                gone = daemon_read(&d, &d.clients[i]);
+            } else if (revents & POLLOUT) {
+                gone = daemon_flush(&d.clients[i]);
+            }
+            if (gone) {
+                daemon_drop(&d, i);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            daemon_accept(&d);
+        }
+    }
+    return_defer(0);
+defer:
+    while (d.clients_sz > 0) {
+        daemon_drop(&d, d.clients_sz - 1);
+    }
+    if (d.listen_fd >= 0) {
+        close(d.listen_fd);
+        unlink(socket_path);
+    }
+    writer_stop();
+    free(d.page);
+    free(d.cache.entries);
+    arena_free(&d.cache.arena);
+    arena_free(&d.page_arena);
+    search_free(&d.search);
+    finalize_read_stmts();
+    finalize_write_stmts();
+    sqlite3_close(WRITER_DB);
+    sqlite3_close(DB);
+    return result;
+}
+
+// Layout
+//
+// The list and search views show as many entries as the terminal has rows for, and are laid out
+// again when it is resized. The filter view scrolls its tags in as many rows as there are.
+
+// Rows of the list, search and filter views that don't show entries or tags: title, blank lines and help
+#define LIST_VIEW_CHROME_ROWS 8
+#define SEARCH_VIEW_CHROME_ROWS 6
+#define FILTER_VIEW_CHROME_ROWS 7
+
+int list_view_height(int rows, int stats_visible) {
+    int height = rows - LIST_VIEW_CHROME_ROWS - (stats_visible ? STATS_ROWS + 1 : 0);
+    return height > 1 ? height : 1;
+}
+
+int search_view_height(int rows) {
+    int height = rows - SEARCH_VIEW_CHROME_ROWS;
+    return height > 1 ? height : 1;
+}
+
+int filter_view_height(int rows) {
+    int height = rows - FILTER_VIEW_CHROME_ROWS;
+    return height > 1 ? height : 1;
+}
+
+// Sizes the frames, the list window and the search results to the terminal. The list loads what the
+// new height needs right away; new search results wait for the query to run again.
+int apply_layout(renderer_t *renderer, list_t *list, search_t *search, int stats_visible) {
+    int rows, cols;
+    get_terminal_size(&rows, &cols);
+    if ((rows != renderer->back.rows || cols != renderer->back.cols) && renderer_resize(renderer, rows, cols) != 0) {
+        return 1;
+    }
+    int height = list_view_height(rows, stats_visible);
+    if (height != list->height && list_set_height(list, height) != 0) {
+        return 1;
+    }
+    height = search_view_height(rows);
+    if (height != search->results_cap) {
+        if (search_set_cap(search, height) != 0) {
+            return 1;
+        }
+        search->dirty = 1;
+    }
+    return 0;
+}
+
+// UI
+//
+// The views and what every key does to them, apart from where keys come from and where frames go:
+// main() reads keys from the terminal and writes frames to it, replay_keys() reads them from a key
+// script and writes frames wherever the renderer's fd points, so the whole UI runs and is timed headless.
+
+#define FILTER_VIEW_MAX_TAGS 256
+
+typedef struct Ui {
+    current_view_t view;
+    list_t list;
+    search_t search;
+    activity_t activity;
+    tag_t tags[FILTER_VIEW_MAX_TAGS]; // offered by the filter view, by name
+    int tags_sz;
+    int tags_cursor;
+    renderer_t renderer;
+    editor_t new_entry_editor;
+    editor_t edit_entry_editor;
+    editor_t search_editor;
+    int stats_visible;
+    int quit; // the list view was left with q or escape
+} ui_t;
+
+int ui_init(ui_t *ui, int rows, int cols) {
+    memset(ui, 0, sizeof(*ui));
+    ui->view = LIST_VIEW;
+    if (list_init(&ui->list, list_view_height(rows, 0)) != 0) {
+        fprintf(stderr, "[error] list_init: out of memory\n");
+        return 1;
+    }
+    if (search_init(&ui->search, search_view_height(rows)) != 0) {
+        fprintf(stderr, "[error] search_init: out of memory\n");
+        return 1;
+    }
+    if (renderer_init(&ui->renderer, rows, cols) != 0) {
+        fprintf(stderr, "[error] renderer_init: out of memory\n");
+        return 1;
+    }
+    editor_init(&ui->new_entry_editor);
+    editor_init(&ui->edit_entry_editor);
+    editor_init(&ui->search_editor);
+    return 0;
+}
+
+void ui_free(ui_t *ui) {
+    renderer_free(&ui->renderer);
+    editor_free(&ui->new_entry_editor);
+    editor_free(&ui->edit_entry_editor);
+    editor_free(&ui->search_editor);
+    list_free(&ui->list);
+    search_free(&ui->search);
+}
+
+// Draws the current view and writes the frame
+int ui_render(ui_t *ui) {
+    render_begin(&ui->renderer);
+    switch (ui->view) {
+    case LIST_VIEW: {
+        // > tday 2026-03-14 (today), filtered by !! #work, 1 changes not saved
+        //
+        // [ ] work on tday
+        // [ ] study opengl
+        // [ ] read japanese
+        //
+        // up (k) / down (j) to move selection, K / J to move the task up / down
+        // space/enter to toggle completed status
+        // (n)ew entry, (e)dit, (d)elete, (p)riority, (x) to clear completed, (f)ilter
+        // left (h) / right (l) to change day, (t)oday, (r)oll over unfinished tasks
+        // (u)ndo, ctrl-r to redo, (/) to search, (a)ctivity, (s)tats, escape to (q)uit
+        int row = 0;
+        char day[DAY_STRING_SIZE];
+        char filter[FILTER_STRING_SIZE];
+        format_day(ui->list.day, day);
+        format_filter(&ui->list.filter, filter);
+        int col = draw_fmt(&ui->renderer, row, 0, ATTR_NONE, "tday %s%s%s%s", day,
+                           ui->list.day == today() ? " (today)" : "", filter[0] != '\0' ? ", filtered by " : "",
+                           filter);
+        pthread_mutex_lock(&stats.mutex);
+        size_t write_failures = stats.write_failures;
+        pthread_mutex_unlock(&stats.mutex);
+        if (write_failures > 0) {
+            draw_fmt(&ui->renderer, row, col, ATTR_YELLOW, ", %zu changes not saved", write_failures);
+        }
+        row += 2;
+        int list_end = ui->list.top + ui->list.height;
+        list_end = list_end < ui->list.entries_sz ? list_end : ui->list.entries_sz;
+        for (int i = ui->list.top; i < list_end; i++, row++) {
+            draw_entry(&ui->renderer, row, &ui->list.entries[i], ui->list.cursor == i);
+        }
+        if (ui->list.entries_sz == 0 && filter[0] != '\0') {
+            draw_text(&ui->renderer, row++, 0, ATTR_NONE, "no entries match the filter", 27);
+        } else if (ui->list.entries_sz == 0) {
+            draw_text(&ui->renderer, row++, 0, ATTR_NONE, "no entries yet", 14);
+        }
+        row++;
+        draw_text(&ui->renderer, row++, 0, ATTR_NONE,
+                  "up (k) / down (j) to move selection, K / J to move the task up / down", 69);
+        draw_text(&ui->renderer, row++, 0, ATTR_NONE, "space/enter to toggle completed status", 38);
+        draw_text(&ui->renderer, row++, 0, ATTR_NONE,
+                  "(n)ew entry, (e)dit, (d)elete, (p)riority, (x) to clear completed, (f)ilter", 76);
+        draw_text(&ui->renderer, row++, 0, ATTR_NONE,
+                  "left (h) / right (l) to change day, (t)oday, (r)oll over unfinished tasks", 73);
+        draw_text(&ui->renderer, row++, 0, ATTR_NONE,
+                  "(u)ndo, ctrl-r to redo, (/) to search, (a)ctivity, (s)tats, escape to (q)uit", 77);
+        if (ui->stats_visible) {
+            row++;
+            stats_draw(&ui->renderer, row);
+        }
+    } break;
+    case NEW_ENTRY_VIEW:
+        // > tday
+        //
+        // new task description:
+        // >
+        //
+        // enter to save, escape to go back
+        draw_text(&ui->renderer, 0, 0, ATTR_NONE, "tday", 4);
+        draw_text(&ui->renderer, 2, 0, ATTR_NONE, "new task description:", 21);
+        draw_text(&ui->renderer, 3, 0, ATTR_NONE, "> ", 2);
+        draw_text(&ui->renderer, 5, 0, ATTR_NONE, "enter to save, escape to go back", 32);
+        editor_draw(&ui->renderer, 3, 2, &ui->new_entry_editor);
+        break;
+    case EDIT_ENTRY_VIEW:
+        // > tday
+        //
+        // description: %
+        // > %
+        //
+        // enter to save, escape to discard changes
+        draw_text(&ui->renderer, 0, 0, ATTR_NONE, "tday", 4);
+        draw_fmt(&ui->renderer, 2, 0, ATTR_NONE, "description: %s", list_selected(&ui->list)->description);
+        draw_text(&ui->renderer, 3, 0, ATTR_NONE, "> ", 2);
+        draw_text(&ui->renderer, 5, 0, ATTR_NONE, "enter to save, escape to discard changes", 40);
+        editor_draw(&ui->renderer, 3, 2, &ui->edit_entry_editor);
+        break;
+    case SEARCH_VIEW: {
+        // > tday
+        //
+        // search: %
+        //
+        // [ ] matching task
+        //
+        // up/down to move selection, enter to go to task, escape to go back
+        int row = 0;
+        draw_text(&ui->renderer, row, 0, ATTR_NONE, "tday", 4);
+        row += 2;
+        draw_text(&ui->renderer, row, 0, ATTR_NONE, "search: ", 8);
+        row += 2;
+        for (int i = 0; i < ui->search.results_sz; i++, row++) {
+            draw_entry(&ui->renderer, row, &ui->search.results[i], ui->search.cursor == i);
+        }
+        if (ui->search.results_sz == 0 && editor_len(&ui->search_editor) > 0 && !ui->search.dirty) {
+            draw_text(&ui->renderer, row++, 0, ATTR_NONE, "no matches", 10);
+        }
+        row++;
+        draw_text(&ui->renderer, row, 0, ATTR_NONE,
+                  "up/down to move selection, enter to go to task, escape to go back", 65);
+        editor_draw(&ui->renderer, 2, 8, &ui->search_editor);
+    } break;
+    case ACTIVITY_VIEW: {
+        // > tday activity
+        //
+        // streak 3 days, longest 12 days
+        //
+        // day                created completed   cleared
+        // 2026-03-14 Sat           4         3         0
+        //
+        // week of            created completed   cleared
+        // 2026-03-09              19        15         9
+        //
+        // left (h) / right (l) to change week, (t)oday, escape to go back
+        static const char *weekdays[] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+        const activity_t *activity = &ui->activity;
+        char label[DAY_STRING_SIZE + 4];
+        int row = 0;
+        draw_text(&ui->renderer, row, 0, ATTR_NONE, "tday activity", 13);
+        row += 2;
+        draw_fmt(&ui->renderer, row, 0, ATTR_NONE, "streak %d day%s, longest %d day%s", activity->streak,
+                 activity->streak == 1 ? "" : "s", activity->longest_streak, activity->longest_streak == 1 ? "" : "s");
+        row += 2;
+        draw_fmt(&ui->renderer, row++, 0, ATTR_NONE, "%-16s %9s %9s %9s", "day", "created", "completed", "cleared");
+        for (int i = 0; i < ACTIVITY_DAYS; i++) {
+            int day = activity->days[i].day;
+            format_day(day, label);
+            snprintf(label + DAY_STRING_SIZE - 1, 5, " %s", weekdays[(day % 7 + 7) % 7]);
+            draw_day_counts(&ui->renderer, row++, label, &activity->days[i]);
+        }
+        row++;
+        draw_fmt(&ui->renderer, row++, 0, ATTR_NONE, "%-16s %9s %9s %9s", "week of", "created", "completed",
+                 "cleared");
+        for (int i = 0; i < ACTIVITY_WEEKS; i++) {
+            format_day(activity->weeks[i].day, label);
+            draw_day_counts(&ui->renderer, row++, label, &activity->weeks[i]);
+        }
+        row++;
+        draw_text(&ui->renderer, row, 0, ATTR_NONE,
+                  "left (h) / right (l) to change week, (t)oday, escape to go back", 63);
+    } break;
+    case FILTER_VIEW: {
+        // > tday filter
+        //
+        // priority: !! and up
+        //
+        // [x] #work
+        // [ ] #home
+        //
+        // up (k) / down (j) to move selection, enter to toggle the tag
+        // (p)riority, (c)lear the filter, escape to go back
+        static const char *priorities[] = {"any", "! and up", "!! and up", "!!!"};
+        const filter_t *filter = &ui->list.filter;
+        int height = filter_view_height(ui->renderer.back.rows);
+        int top = ui->tags_cursor < height ? 0 : ui->tags_cursor - height + 1;
+        int end = top + height < ui->tags_sz ? top + height : ui->tags_sz;
+        int row = 0;
+        draw_text(&ui->renderer, row, 0, ATTR_NONE, "tday filter", 11);
+        row += 2;
+        draw_fmt(&ui->renderer, row, 0, ATTR_NONE, "priority: %s", priorities[filter->priority]);
+        row += 2;
+        for (int i = top; i < end; i++, row++) {
+            const tag_t *tag = &ui->tags[i];
+            int col = ui->tags_cursor == i ? draw_text(&ui->renderer, row, 0, ATTR_YELLOW, "> ", 2) : 2;
+            draw_fmt(&ui->renderer, row, col, ATTR_NONE, "[%c] #%s", filter_has_tag(filter, tag->id) ? 'x' : ' ',
+                     tag->name);
+        }
+        if (ui->tags_sz == 0) {
+            draw_text(&ui->renderer, row++, 0, ATTR_NONE, "no tags yet, write #name in a task to tag it", 44);
+        }
+        row++;
+        draw_text(&ui->renderer, row++, 0, ATTR_NONE,
+                  "up (k) / down (j) to move selection, enter to toggle the tag", 60);
+        draw_text(&ui->renderer, row, 0, ATTR_NONE, "(p)riority, (c)lear the filter, escape to go back", 49);
+    } break;
+    }
+    return render_flush(&ui->renderer);
+}
+
+// Shows the activity up to end, or up to today for a later day
+void ui_show_activity(ui_t *ui, int end) {
+    int now = today();
+    load_activity(end < now ? end : now, now, &ui->activity);
+    ui->view = ACTIVITY_VIEW;
+}
+
+// Offers the tags of the tasks to filter the list with
+void ui_show_filter(ui_t *ui) {
+    load_tags(ui->tags, FILTER_VIEW_MAX_TAGS, &ui->tags_sz);
+    if (ui->tags_cursor >= ui->tags_sz) {
+        ui->tags_cursor = ui->tags_sz > 0 ? ui->tags_sz - 1 : 0;
+    }
+    ui->view = FILTER_VIEW;
+}
+
+// Applies one key, as read by input_next() from input
+void ui_handle_key(ui_t *ui, const input_t *input, int key) {
+    editor_t *editor = NULL;
+    switch (ui->view) {
+    case LIST_VIEW:
+        editor = NULL;
+        break;
+    case NEW_ENTRY_VIEW:
+        editor = &ui->new_entry_editor;
+        break;
+    case EDIT_ENTRY_VIEW:
+        editor = &ui->edit_entry_editor;
+        break;
+    case SEARCH_VIEW:
+        editor = &ui->search_editor;
+        break;
+    case ACTIVITY_VIEW:
+    case FILTER_VIEW:
+        editor = NULL;
+        break;
+    }
+
+    switch (key) {
+    case '\n': // ENTER
+        switch (ui->view) {
+        case LIST_VIEW:
+            list_toggle_selected(&ui->list);
+            break;
+        case NEW_ENTRY_VIEW: {
+            int len;
+            const char *text = editor_text(editor, &len);
+            list_add(&ui->list, text, len);
+            editor_clear(editor);
+            ui->view = LIST_VIEW;
+        } break;
+        case EDIT_ENTRY_VIEW: {
+            if (editor_len(editor) == 0)
+                break;
+
+            int len;
+            const char *text = editor_text(editor, &len);
+            list_edit_selected(&ui->list, text, len);
+            editor_clear(editor);
+            ui->view = LIST_VIEW;
+        } break;
+        case SEARCH_VIEW:
+            if (ui->search.results_sz == 0)
+                break;
+
+            list_focus(&ui->list, &ui->search.results[ui->search.cursor]);
+            editor_clear(editor);
+            ui->view = LIST_VIEW;
+            break;
+        case ACTIVITY_VIEW:
+            break;
+        case FILTER_VIEW:
+            if (ui->tags_sz > 0) {
+                filter_t filter = ui->list.filter;
+                if (filter_toggle_tag(&filter, &ui->tags[ui->tags_cursor]) == 0) {
+                    list_set_filter(&ui->list, &filter);
+                }
+            }
+            break;
+        }
+        break;
+    case 's':
+        switch (ui->view) {
+        case LIST_VIEW:
+            ui->stats_visible = !ui->stats_visible;
+            list_set_height(&ui->list, list_view_height(ui->renderer.back.rows, ui->stats_visible));
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case '/':
+        switch (ui->view) {
+        case LIST_VIEW:
+            ui->view = SEARCH_VIEW;
+            ui->search.results_sz = 0;
+            ui->search.dirty = 1;
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case 'e':
+        switch (ui->view) {
+        case LIST_VIEW:
+            if (ui->list.entries_sz > 0) {
+                entry_t *entry = list_selected(&ui->list);
+                editor_set(&ui->edit_entry_editor, entry->description, strlen(entry->description));
+                ui->view = EDIT_ENTRY_VIEW;
+            }
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case 'd':
+        switch (ui->view) {
+        case LIST_VIEW:
+            list_delete_selected(&ui->list);
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case 'x':
+        switch (ui->view) {
+        case LIST_VIEW:
+            list_clear_completed(&ui->list);
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case 'n':
+        switch (ui->view) {
+        case LIST_VIEW:
+            ui->view = NEW_ENTRY_VIEW;
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case 'q':
+        switch (ui->view) {
+        case LIST_VIEW:
+            ui->quit = 1;
+            break;
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            ui->view = LIST_VIEW;
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case 'f':
+        switch (ui->view) {
+        case LIST_VIEW:
+            ui_show_filter(ui);
+            break;
+        case FILTER_VIEW:
+            ui->view = LIST_VIEW;
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+        case ACTIVITY_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case 'p':
+        switch (ui->view) {
+        case LIST_VIEW:
+            if (ui->list.entries_sz > 0) {
+                int priority = description_priority(list_selected(&ui->list)->description);
+                list_set_priority_selected(&ui->list, (priority + 1) % (PRIORITY_MAX + 1));
+            }
+            break;
+        case FILTER_VIEW: {
+            filter_t filter = ui->list.filter;
+            filter.priority = (filter.priority + 1) % (PRIORITY_MAX + 1);
+            list_set_filter(&ui->list, &filter);
+        } break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+        case ACTIVITY_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case 'c':
+        if (ui->view == FILTER_VIEW) {
+            filter_t none = {0};
+            list_set_filter(&ui->list, &none);
+        } else {
+            goto treat_as_char;
+        }
+        break;
+    case 'a':
+        switch (ui->view) {
+        case LIST_VIEW:
+            ui_show_activity(ui, today());
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            goto treat_as_char;
+        }
+        break;
+    case KEY_BACKSPACE:
+        if (editor != NULL) {
+            editor_backspace(editor);
+            ui->search.dirty = ui->view == SEARCH_VIEW;
+        }
+        break;
+    case KEY_DELETE:
+        if (editor != NULL) {
+            editor_delete(editor);
+            ui->search.dirty = ui->view == SEARCH_VIEW;
+        }
+        break;
+    case 'k':
+        if (ui->view == LIST_VIEW) {
+            list_move(&ui->list, -1);
+        } else if (ui->view == FILTER_VIEW && ui->tags_cursor > 0) {
+            ui->tags_cursor--;
+        } else if (ui->view != FILTER_VIEW) {
+            goto treat_as_char;
+        }
+        break;
+    case 'j':
+        if (ui->view == LIST_VIEW) {
+            list_move(&ui->list, 1);
+        } else if (ui->view == FILTER_VIEW && ui->tags_cursor + 1 < ui->tags_sz) {
+            ui->tags_cursor++;
+        } else if (ui->view != FILTER_VIEW) {
+            goto treat_as_char;
+        }
+        break;
+    case 'K':
+        if (ui->view == LIST_VIEW) {
+            list_move_selected(&ui->list, -1);
+        } else {
+            goto treat_as_char;
+        }
+        break;
+    case 'J':
+        if (ui->view == LIST_VIEW) {
+            list_move_selected(&ui->list, 1);
+        } else {
+            goto treat_as_char;
+        }
+        break;
+    case KEY_ARROW_UP:
+        if (ui->view == LIST_VIEW) {
+            list_move(&ui->list, -1);
+        } else if (ui->view == SEARCH_VIEW && ui->search.cursor > 0) {
+            ui->search.cursor--;
+        } else if (ui->view == FILTER_VIEW && ui->tags_cursor > 0) {
+            ui->tags_cursor--;
+        }
+        break;
+    case KEY_ARROW_DOWN:
+        if (ui->view == LIST_VIEW) {
+            list_move(&ui->list, 1);
+        } else if (ui->view == SEARCH_VIEW && ui->search.cursor + 1 < ui->search.results_sz) {
+            ui->search.cursor++;
+        } else if (ui->view == FILTER_VIEW && ui->tags_cursor + 1 < ui->tags_sz) {
+            ui->tags_cursor++;
+        }
+        break;
+    case 'h':
+        if (ui->view == LIST_VIEW) {
+            list_show_day(&ui->list, ui->list.day - 1);
+        } else if (ui->view == ACTIVITY_VIEW) {
+            ui_show_activity(ui, ui->activity.end - 7);
+        } else {
+            goto treat_as_char;
+        }
+        break;
+    case 'l':
+        if (ui->view == LIST_VIEW) {
+            list_show_day(&ui->list, ui->list.day + 1);
+        } else if (ui->view == ACTIVITY_VIEW) {
+            ui_show_activity(ui, ui->activity.end + 7);
+        } else {
+            goto treat_as_char;
+        }
+        break;
+    case 't':
+        if (ui->view == LIST_VIEW) {
+            list_show_day(&ui->list, today());
+        } else if (ui->view == ACTIVITY_VIEW) {
+            ui_show_activity(ui, today());
+        } else {
+            goto treat_as_char;
+        }
+        break;
+    case 'r':
+        if (ui->view == LIST_VIEW) {
+            list_rollover(&ui->list);
+        } else {
+            goto treat_as_char;
+        }
+        break;
+    case 'u':
+        if (ui->view == LIST_VIEW) {
+            list_undo(&ui->list);
+        } else {
+            goto treat_as_char;
+        }
+        break;
+    case KEY_CTRL_R:
+        if (ui->view == LIST_VIEW) {
+            list_redo(&ui->list);
+        } else {
+            goto treat_as_char;
+        }
+        break;
+    case KEY_ARROW_RIGHT:
+        if (ui->view == LIST_VIEW) {
+            list_show_day(&ui->list, ui->list.day + 1);
+        } else if (ui->view == ACTIVITY_VIEW) {
+            ui_show_activity(ui, ui->activity.end + 7);
+        } else if (editor != NULL) {
+            editor_right(editor);
+        }
+        break;
+    case KEY_ARROW_LEFT:
+        if (ui->view == LIST_VIEW) {
+            list_show_day(&ui->list, ui->list.day - 1);
+        } else if (ui->view == ACTIVITY_VIEW) {
+            ui_show_activity(ui, ui->activity.end - 7);
+        } else if (editor != NULL) {
+            editor_left(editor);
+        }
+        break;
+    case KEY_HOME:
+        if (editor != NULL) {
+            editor_home(editor);
+        }
+        break;
+    case KEY_END:
+        if (editor != NULL) {
+            editor_end(editor);
+        }
+        break;
+    case KEY_ESCAPE:
+        switch (ui->view) {
+        case LIST_VIEW:
+            ui->quit = 1;
+            break;
+        case NEW_ENTRY_VIEW:
+            // Don't discard changes
+            ui->view = LIST_VIEW;
+            break;
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW:
+            // Discard changes
+            ui->view = LIST_VIEW;
+            editor_clear(editor);
+            break;
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            ui->view = LIST_VIEW;
+            break;
+        }
+        break;
+    case KEY_PASTE:
+        if (editor != NULL) {
+            editor_insert(editor, input->paste, input->paste_len);
+            ui->search.dirty = ui->view == SEARCH_VIEW;
+        }
+        break;
+    default:
+    treat_as_char:
+        switch (ui->view) {
+        case LIST_VIEW:
+        case ACTIVITY_VIEW:
+        case FILTER_VIEW:
+            break;
+        case NEW_ENTRY_VIEW:
+        case EDIT_ENTRY_VIEW:
+        case SEARCH_VIEW: {
+            char ch = key;
+            editor_insert(editor, &ch, 1);
+            ui->search.dirty = ui->view == SEARCH_VIEW;
+        } break;
+        }
+        break;
+    }
+}
+
+// Feeds the keys read from fd to ui one at a time, rendering a frame after each, until they run out or
+// quit the list. The search runs right away instead of after SEARCH_DEBOUNCE_MS, so a replay always
+// draws the same frames. The time from each key to its frame goes to stats.key_to_flush. Returns the
+// number of keys replayed, -1 if the first frame could not be drawn.
+long replay_keys(ui_t *ui, int fd) {
+    input_t input;
+    long replayed = 0;
+    input_init(&input, fd);
+    list_reload(&ui->list);
+    if (ui_render(ui) != 0) {
+        input_free(&input);
+        return -1;
+    }
+    while (!ui->quit && input_read(&input) == 0) {
+        int key;
+        while (!ui->quit && (key = input_next(&input)) != KEY_NONE) {
+            double start = now_us();
+            ui_handle_key(ui, &input, key);
+            if (ui->search.dirty && ui->view == SEARCH_VIEW) {
+                int len;
+                const char *text = editor_text(&ui->search_editor, &len);
+                search_entries(&ui->search, text, len);
+            }
+            double frame_start = now_us();
+            ui_render(ui);
+            double end = now_us();
+            histogram_add(&stats.render, end - frame_start);
+            histogram_add(&stats.key_to_flush, end - start);
+            replayed++;
+        }
+    }
+    input_free(&input);
+    return replayed;
+}
+
+// Draws the first frame as early as it can: connects to the daemon, or opens the database and loads
+// the first page from it, and only then starts the writer, which nothing needs before the first key.
+// Every phase is timed, see Startup.
+int ui_start(ui_t *ui, const char *db_path, const char *socket_path) {
+    startup_mark(STARTUP_INIT);
+    // With a daemon running, every read and write goes through it instead
+    if (client_connect(socket_path) == 0) {
+        startup_mark(STARTUP_OPEN);
+    } else if (open_db(db_path) == 0) {
+        stats_trace_conn(DB);
+    } else {
+        return 1;
+    }
+    list_reload(&ui->list);
+    startup_mark(STARTUP_FIRST_PAGE);
+    double frame_start = now_us();
+    if (ui_render(ui) != 0) {
+        return 1;
+    }
+    histogram_add(&stats.render, now_us() - frame_start);
+    startup_mark(STARTUP_FIRST_FRAME);
+    if (client.fd < 0) {
+        if (writer_start(db_path) != 0) {
+            return 1;
+        }
+        stats_trace_conn(WRITER_DB);
+    }
+    startup_mark(STARTUP_WRITER);
+    return 0;
+}
+
+// bench.c includes this file with TDAY_NO_MAIN defined to time the real code paths
+#ifndef TDAY_NO_MAIN
+
+// Event loop callbacks of the interactive UI
+
+#define RESIZE_SETTLE_MS 30
+
+typedef struct ResizeJob {
+    loop_timer_t settle;
+    int pending; // the terminal was resized and the layout has not caught up yet
+} resize_job_t;
+
+typedef struct SearchJob {
+    search_t *search;
+    editor_t *query;
+} search_job_t;
+
+typedef struct ReloadJob {
+    list_t *list;
+    search_job_t *search;
+    activity_t *activity;
+    ui_t *ui; // for the tags of the filter view
+    const current_view_t *view;
+    int pending; // another process changed the database since the list was loaded
+} reload_job_t;
+
+void on_stdin_readable(loop_t *loop, void *ctx) {
+    input_t *input = ctx;
+    (void)loop;
+    if (input_read(input) != 0) {
+        input->closed = 1;
+    }
+}
+
+void on_writer_notify(loop_t *loop, void *ctx) {
+    reload_job_t *reload = ctx;
+    (void)loop;
+    char drain[64];
+    while (read(writer.notify[0], drain, sizeof(drain)) > 0) {
+    }
+    reload->pending = 1;
+}
+
+void on_resize_settled(loop_t *loop, void *ctx) {
+    resize_job_t *job = ctx;
+    job->pending = 1;
+    loop->redraw = 1;
+}
+
+// Dragging a window edge sends a stream of SIGWINCH. The layout is redone once, after the size has
+// stopped changing for RESIZE_SETTLE_MS.
+void on_resize_signal(loop_t *loop, void *ctx) {
+    resize_job_t *job = ctx;
+    char drain[64];
+    while (read(resize_pipe[0], drain, sizeof(drain)) > 0) {
+    }
+    loop_timer_start(loop, &job->settle, RESIZE_SETTLE_MS, 0, on_resize_settled, job);
+}
+
+// A client asks the daemon, which keeps track of every change
+void on_check_changes(loop_t *loop, void *ctx) {
+    reload_job_t *reload = ctx;
+    (void)loop;
+    if (client.fd >= 0) {
+        reload->pending |= client_check_changes() == 1;
+    } else {
+        writer_check_changes();
+    }
+}
+
+void run_search(loop_t *loop, void *ctx) {
+    search_job_t *job = ctx;
+    if (!job->search->dirty) {
+        return;
+    }
+    int len;
+    const char *text = editor_text(job->query, &len);
+    search_entries(job->search, text, len);
+    loop->redraw = 1;
+}
+
+void on_search_debounced(loop_t *loop, void *ctx) { loop_post(loop, run_search, ctx); }
+
+// Shows another process's changes. While an entry is being edited the list is left alone, and the
+// reload is posted again once the edit ends.
+void run_reload(loop_t *loop, void *ctx) {
+    reload_job_t *job = ctx;
+    if (*job->view == EDIT_ENTRY_VIEW) {
+        return;
+    }
+    job->pending = 0;
+    list_reload(job->list);
+    if (*job->view == SEARCH_VIEW) {
+        job->search->search->dirty = 1;
+        loop_post(loop, run_search, job->search);
+    }
+    if (*job->view == ACTIVITY_VIEW) {
+        load_activity(job->activity->end, today(), job->activity);
+    }
+    if (*job->view == FILTER_VIEW) {
+        ui_show_filter(job->ui);
+    }
+    loop->redraw = 1;
+}
+
+// Runs the UI headless on the key script at path, "-" for stdin, at DEFAULT_ROWS x DEFAULT_COLS. The
+// frames go to stdout instead of a terminal, the timings to stderr and stats_file_path.
+int replay_run(const char *path) {
+    int result = 0;
+    ui_t ui;
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "[error] open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    if (ui_init(&ui, DEFAULT_ROWS, DEFAULT_COLS) != 0) {
+        return_defer(1);
+    }
+    if (open_db(db_file_path) != 0 || writer_start(db_file_path) != 0) {
+        return_defer(1);
+    }
+    stats_trace_conn(DB);
+    stats_trace_conn(WRITER_DB);
+
+    double start = now_us();
+    long keys = replay_keys(&ui, fd);
+    if (keys < 0) {
+        return_defer(1);
+    }
+    fprintf(stderr, "replayed %ld keys in %.1fms, p50 %.0fus p99 %.0fus per key, %zu bytes in %zu frames\n", keys,
+            (now_us() - start) / 1e3, histogram_percentile(&stats.key_to_flush, 0.5),
+            histogram_percentile(&stats.key_to_flush, 0.99), ui.renderer.total_bytes, ui.renderer.frames);
+    return_defer(0);
+defer:
+    writer_stop();
+    if (ui.renderer.frames > 0 && stats_dump(stats_file_path, &ui.renderer) != 0) {
+        fprintf(stderr, "[error] stats_dump: could not write %s\n", stats_file_path);
+    }
+    ui_free(&ui);
+    history_free();
+    finalize_read_stmts();
+    finalize_write_stmts();
+    sqlite3_close(WRITER_DB);
+    sqlite3_close(DB);
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    return result;
+}
+
+// Starts up like the interactive UI at DEFAULT_ROWS x DEFAULT_COLS, with the first frame written to
+// stdout instead of a terminal, then prints how long each phase took to stderr
+int startup_run(void) {
+    int result = 0;
+    ui_t ui;
+    if (ui_init(&ui, DEFAULT_ROWS, DEFAULT_COLS) != 0 || ui_start(&ui, db_file_path, socket_file_path) != 0) {
+        return_defer(1);
+    }
+    startup_report(stderr);
+    return_defer(0);
+defer:
+    writer_stop();
+    ui_free(&ui);
+    client_close();
+    finalize_read_stmts();
+    finalize_write_stmts();
+    sqlite3_close(WRITER_DB);
+    sqlite3_close(DB);
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int result = 0;
+    startup_begin();
+
+    if (argc > 1 && strcmp(argv[1], "--daemon") == 0) {
+        return daemon_run(db_file_path, socket_file_path);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0) {
+        if (argc < 3) {
+            usage();
+            return 1;
+        }
+        return replay_run(argv[2]);
+    }
+
+    if (argc > 1 && strcmp(argv[1], "--time-startup") == 0) {
+        return startup_run();
+    }
+
+    if (argc > 1) {
+        if (open_db(db_file_path) == 0) {
+            WRITER_DB = DB;
+            result = run_command(argc - 1, argv + 1) != 0;
+        } else {
+            result = 1;
+        }
+        finalize_write_stmts();
+        sqlite3_close(DB);
+        return result;
+    }
+
+    int rows, cols;
+    get_terminal_size(&rows, &cols);
+
+    ui_t ui;
+    if (ui_init(&ui, rows, cols) != 0) {
+        ui_free(&ui);
+        return 1;
+    }
+
+    input_t input;
+    input_init(&input, STDIN_FILENO);
+
+    struct termios old_tio;
+    set_raw_mode(&old_tio);
+
+    if (ui_start(&ui, db_file_path, socket_file_path) != 0) {
+        return_defer(1);
+    }
+
+    search_job_t search_job = {.search = &ui.search, .query = &ui.search_editor};
+    reload_job_t reload_job = {
+        .list = &ui.list, .search = &search_job, .activity = &ui.activity, .ui = &ui, .view = &ui.view};
+    resize_job_t resize_job = {0};
+    loop_timer_t check_changes_timer = {0};
+    loop_timer_t search_timer = {0};
+    loop_t loop;
+    loop_init(&loop);
+    if (resize_signal_init() != 0) {
+        fprintf(stderr, "[error] resize_signal_init: %s\n", strerror(errno));
+        return_defer(1);
+    }
+    loop_watch(&loop, STDIN_FILENO, on_stdin_readable, &input);
+    if (writer.running) {
+        loop_watch(&loop, writer.notify[0], on_writer_notify, &reload_job);
+    }
+    loop_watch(&loop, resize_pipe[0], on_resize_signal, &resize_job);
+    loop_timer_start(&loop, &check_changes_timer, EXTERNAL_CHANGE_POLL_MS, EXTERNAL_CHANGE_POLL_MS, on_check_changes,
+                     &reload_job);
+
+    double key_read_at = 0;
+
+    while (1) {
+        if (reload_job.pending && ui.view != EDIT_ENTRY_VIEW) {
+            loop_post(&loop, run_reload, &reload_job);
+        }
+        if (resize_job.pending) {
+            resize_job.pending = 0;
+            if (apply_layout(&ui.renderer, &ui.list, &ui.search, ui.stats_visible) != 0) {
+                fprintf(stderr, "[error] apply_layout: could not resize the views\n");
+                return_defer(1);
+            }
+            if (ui.search.dirty && ui.view == SEARCH_VIEW) {
+                loop_post(&loop, run_search, &search_job);
+            }
+        }
+        if (loop.redraw) {
+            loop.redraw = 0;
+            double frame_start = now_us();
+            ui_render(&ui);
+            histogram_add(&stats.render, now_us() - frame_start);
+            if (key_read_at > 0) {
+                histogram_add(&stats.key_to_flush, now_us() - key_read_at);
+                key_read_at = 0;
+            }
+        }
+
+        // Sleep until a key, another process's commit or a timer
+        if (loop_run_once(&loop) != 0 || input.closed) {
+            return_defer(0);
+        }
+
+        // Apply every key that was read before rendering again
+        int key;
+        while ((key = input_next(&input)) != KEY_NONE) {
+            if (!loop.redraw) {
+                key_read_at = now_us();
+                loop.redraw = 1;
+            }
+            ui_handle_key(&ui, &input, key);
+            if (ui.quit) {
+                return_defer(0);
+            }
+        }
+        // Every key that changes the query pushes the search back by SEARCH_DEBOUNCE_MS
+        if (loop.redraw && ui.search.dirty && ui.view == SEARCH_VIEW) {
+            loop_timer_start(&loop, &search_timer, SEARCH_DEBOUNCE_MS, 0, on_search_debounced, &search_job);
+        }
+    }
+
+defer:
+    render_finish(&ui.renderer);
+    restore_terminal_mode(&old_tio);
+    printf("Quitting program...\n");
+    writer_stop();
+    if (ui.renderer.frames > 0 && stats_dump(stats_file_path, &ui.renderer) != 0) {
+        fprintf(stderr, "[error] stats_dump: could not write %s\n", stats_file_path);
+    }
+    ui_free(&ui);
+    input_free(&input);
+    history_free();
+    client_close();
+    finalize_read_stmts();
+    finalize_write_stmts();
+    sqlite3_close(WRITER_DB);
     sqlite3_close(DB);
     return result;
 }
+#endif // TDAY_NO_MAIN